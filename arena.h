@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+
+// Fixed-capacity bump allocator. Everything carved out of an arena lives in one contiguous,
+// zero-initialized block, and is released all at once when the arena is destroyed.
+class Arena {
+private:
+    struct Free {
+        void operator()(std::byte* p) const { std::free(p); }
+    };
+
+    std::unique_ptr<std::byte, Free> block;
+    std::size_t capacity = 0, used = 0;
+public:
+    // every allocation starts on its own cache line
+    static const std::size_t ALIGNMENT = 64;
+
+    // Returns the number of arena bytes taken up by an allocation of n objects of type T
+    template <class T>
+    static std::size_t footprint(std::size_t n) {
+        return (n * sizeof(T) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    Arena() = default;
+
+    explicit Arena(std::size_t capacity) : capacity(footprint<std::byte>(capacity)) {
+        if (this->capacity == 0)
+            return;
+        this->block.reset(static_cast<std::byte*>(std::aligned_alloc(ALIGNMENT, this->capacity)));
+        if (!this->block)
+            throw std::bad_alloc();
+        std::memset(this->block.get(), 0, this->capacity);
+    }
+
+    Arena(Arena&&) = default;
+    Arena& operator=(Arena&&) = default;
+
+    // Carve out n zeroed objects of trivially constructible type T
+    template <class T>
+    T* allocate(std::size_t n) {
+        std::size_t size = footprint<T>(n);
+        if (this->used + size > this->capacity)
+            throw std::bad_alloc();
+        T* p = reinterpret_cast<T*>(this->block.get() + this->used);
+        this->used += size;
+        return p;
+    }
+
+    // Zero everything allocated so far, keeping the allocations in place
+    void clear() {
+        if (this->used)
+            std::memset(this->block.get(), 0, this->used);
+    }
+
+    std::size_t get_used() const { return this->used; }
+
+    std::size_t get_capacity() const { return this->capacity; }
+};
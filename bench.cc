@@ -0,0 +1,290 @@
+#include "blotto.h"
+#include "dudo.h"
+#include "kuhn.h"
+#include "rps.h"
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+using namespace std;
+
+// Benchmarks every solver headless, at fixed seeds and iteration counts, so that runs on the same
+// machine are comparable. Each case reports:
+//
+//   iters/s      - training iterations per second of wall time
+//   ns/visit     - wall time per node visit. For the CFR games a visit is one history walked for
+//                  one deal (one history for all of them on the public tree); for the matrix
+//                  games it is one payoff evaluated. Built with -DCFR_STATS, the CFR visits are
+//                  those counted by the solver; otherwise they are worked out from the tree size,
+//                  and sampled or pruned CFR, which visit a varying number of nodes, report no
+//                  figure.
+//   peak RSS     - peak resident set size while the case ran, solver construction included
+//   to target    - training time until the exploitability first drops below the case's target,
+//                  checked at fixed intervals that are not timed themselves
+//
+// usage: bench [--filter SUBSTRING] [--threads N]
+//
+// Only cases whose name contains SUBSTRING are run. N is the thread count of the threaded cases.
+
+struct Result {
+    long iterations = 0;
+    double seconds = 0;
+    // node visits over the timed run, 0 if they can't be counted in advance
+    double visits = 0;
+    long peak_rss_kb = 0;
+    double exploitability = 0;
+    // -1 if the target was not reached
+    double time_to_target = -1;
+};
+
+struct Case {
+    string name;
+    // exploitability to time the training to
+    double target;
+    function<Result(const Case&)> run;
+};
+
+// Resets the peak resident set size reported by get_peak_rss, where the kernel supports it. The
+// heap freed by earlier cases is handed back first, so that it isn't counted against the next.
+void reset_peak_rss() {
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+    ofstream("/proc/self/clear_refs") << "5";
+}
+
+// Returns the peak resident set size in KiB since the last reset_peak_rss. Without procfs it is
+// the peak of the whole process.
+long get_peak_rss() {
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line))
+        if (line.starts_with("VmHWM:"))
+            return stol(line.substr(6));
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+double seconds_since(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Times train(solver, T) on a fresh solver from make(), then times a second fresh solver to the
+// case's target, training check_every iterations between checks, for at most max_iterations.
+// train returns how many iterations it actually ran, and visits(solver, iterations) how many
+// nodes those visited.
+template <class Make, class Train, class Exploitability, class Visits>
+Result run_case(const Case& c, Make make, Train train, Exploitability exploitability,
+                Visits visits, int T, int check_every, long max_iterations) {
+    Result res;
+    reset_peak_rss();
+    {
+        auto solver = make();
+        auto start = chrono::steady_clock::now();
+        res.iterations = train(solver, T);
+        res.seconds = seconds_since(start);
+        res.peak_rss_kb = get_peak_rss();
+        res.visits = visits(solver, res.iterations);
+        res.exploitability = exploitability(solver);
+    }
+
+    auto solver = make();
+    double elapsed = 0;
+    for (long i = 0; i < max_iterations; i += check_every) {
+        auto start = chrono::steady_clock::now();
+        train(solver, check_every);
+        elapsed += seconds_since(start);
+        if (exploitability(solver) < c.target) {
+            res.time_to_target = elapsed;
+            break;
+        }
+    }
+    return res;
+}
+
+// Returns the number of histories a walk from h visits, filling walk[h] with it
+template <class Table>
+double count_walk(const Table& table, int h, vector<double>& walk) {
+    if (walk[h] == 0) {
+        walk[h] = 1;
+        if (!table.is_terminal(h))
+            for (int a = table.get_first_action(h); a < table.get_last_action(h); ++a)
+                walk[h] += count_walk(table, table.get_child(h, a), walk);
+    }
+    return walk[h];
+}
+
+// Returns the visits of one iteration of a CFR solver with options, or 0 if it samples or prunes
+template <class Traits>
+double get_visits_per_iteration(const SolverOptions& options) {
+    if (options.sampling != Sampling::NONE || options.prune_threshold < 0)
+        return 0;
+    // histories that play out alike may share an id, and a walk visits them once per path
+    typename Traits::Table table;
+    vector<double> walk(table.get_n_histories());
+    double n_histories = count_walk(table, Traits::Table::ROOT, walk);
+    if (options.public_tree)
+        return n_histories;
+    // threaded iterations walk every deal, sequential ones a single deal
+    return (options.n_threads > 1) ? n_histories * Traits::get_deals().size() : n_histories;
+}
+
+template <class Traits, class Real = double>
+Case cfr_case(string name, SolverOptions options, int T, double target, int check_every,
+              long max_iterations) {
+    typedef CfrSolver<Traits, Real> Solver;
+    return {name, target, [=](const Case& c) {
+        return run_case(c,
+            [&] { return Solver(options); },
+            [](Solver& solver, int n) {
+                long start = solver.get_iteration();
+                solver.train(n);
+                return solver.get_iteration() - start;
+            },
+            [](Solver& solver) { return solver.compute_exploitability(); },
+            [&](Solver& solver, long iterations) {
+                if constexpr (STATS_ENABLED)
+                    return (double) solver.get_stats().get(Counter::NODE_VISITS);
+                return iterations * get_visits_per_iteration<Traits>(options);
+            },
+            T, check_every, max_iterations);
+    }};
+}
+
+// Case for a matrix game solver made by make, trained with train_full_width if full_width is set
+template <class Make>
+Case matrix_case(string name, Make make, bool full_width, int T, double target, int check_every,
+                 long max_iterations) {
+    int n = make().get_n_actions();
+    // a full-width iteration evaluates every action pair, a sampled one a row and a column
+    double visits = full_width ? (double) n * n : 2 * n + 1;
+    return {name, target, [=](const Case& c) {
+        return run_case(c, make,
+            [=](auto& solver, int n_iterations) {
+                if (full_width)
+                    solver.train_full_width(n_iterations);
+                else
+                    solver.train_sampled(n_iterations);
+                return (long) n_iterations;
+            },
+            [](auto& solver) { return solver.get_exploitability(); },
+            [=](auto&, long iterations) { return iterations * visits; },
+            T, check_every, max_iterations);
+    }};
+}
+
+vector<Case> get_cases(int n_threads) {
+    const uint64_t SEED = 1;
+    auto make_rps = [] { return rps::Solver(rps::UTILITY, rps::NUM_ACTIONS, SEED); };
+    auto make_blotto = [] {
+        return blotto::Solver(blotto::Payoff(), blotto::NUM_ACTIONS, SEED);
+    };
+
+    return {
+        cfr_case<kuhn::KuhnTraits>("kuhn/cfr", {}, 100000, 0.005, 1000, 1000000),
+        cfr_case<kuhn::KuhnTraits>("kuhn/dcfr", {.policy = RegretPolicy::DCFR}, 100000, 0.005,
+                                   1000, 1000000),
+        cfr_case<kuhn::KuhnTraits>("kuhn/public-tree", {.public_tree = true}, 100000, 0.005,
+                                   100, 1000000),
+        cfr_case<kuhn::KuhnTraits>("kuhn/threads", {.n_threads = n_threads}, 10000, 0.005, 100,
+                                   100000),
+        cfr_case<kuhn::KuhnTraits>("kuhn/chance", {.sampling = Sampling::CHANCE, .seed = SEED},
+                                   100000, 0.005, 1000, 1000000),
+        cfr_case<kuhn::KuhnTraits>("kuhn/external",
+                                   {.sampling = Sampling::EXTERNAL, .seed = SEED}, 100000, 0.005,
+                                   1000, 1000000),
+        cfr_case<kuhn::KuhnTraits>("kuhn/outcome", {.sampling = Sampling::OUTCOME, .seed = SEED},
+                                   100000, 0.005, 1000, 1000000),
+        cfr_case<dudo::DudoTraits>("dudo/cfr", {}, 2000, 0.05, 500, 20000),
+        cfr_case<dudo::DudoTraits>("dudo/public-tree", {.public_tree = true}, 200, 0.05, 20,
+                                   1000),
+        // pruning only pays once strategies concentrate, so these run for longer
+        cfr_case<dudo::DudoTraits>("dudo/prune", {.prune_threshold = -100}, 20000, 0.02, 2000,
+                                   100000),
+        cfr_case<dudo::DudoTraits>("dudo/prune-public-tree",
+                                   {.public_tree = true, .prune_threshold = -100}, 1000, 0.02, 100,
+                                   5000),
+        cfr_case<dudo::DudoTraits, float>("dudo/float", {}, 2000, 0.05, 500, 20000),
+        cfr_case<dudo::DudoTraits, float>("dudo/float-public-tree", {.public_tree = true}, 200,
+                                          0.05, 20, 1000),
+        cfr_case<dudo::DudoTraits>("dudo/threads", {.n_threads = n_threads}, 50, 0.05, 20, 1000),
+        cfr_case<dudo::DudoTraits>("dudo/external", {.sampling = Sampling::EXTERNAL, .seed = SEED},
+                                   100000, 0.05, 10000, 1000000),
+        cfr_case<dudo::DudoTraits>("dudo/external-prune",
+                                   {.sampling = Sampling::EXTERNAL, .seed = SEED,
+                                    .prune_threshold = -100},
+                                   100000, 0.05, 10000, 1000000),
+        cfr_case<dudo::DudoTraits>("dudo/outcome", {.sampling = Sampling::OUTCOME, .seed = SEED},
+                                   1000000, 0.05, 100000, 2000000),
+        matrix_case("rps/sampled", make_rps, false, 1000000, 0.01, 10000, 1000000),
+        matrix_case("rps/full-width", make_rps, true, 1000000, 0.01, 10000, 1000000),
+        matrix_case("blotto/sampled", make_blotto, false, 100000, 0.01, 1000, 100000),
+        matrix_case("blotto/full-width", make_blotto, true, 100000, 0.01, 1000, 100000),
+    };
+}
+
+int main(int argc, char** argv) {
+    string filter;
+    int n_threads = 2;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            cerr << "missing value for " << arg << '\n';
+            return 1;
+        }
+        string value = argv[++i];
+        if (arg == "--filter") {
+            filter = value;
+        } else if (arg == "--threads") {
+            try {
+                n_threads = stoi(value);
+            } catch (const logic_error&) {
+                cerr << "bad value for " << arg << ": " << value << '\n';
+                return 1;
+            }
+        } else {
+            cerr << "unknown option " << arg << '\n';
+            return 1;
+        }
+    }
+
+    cout << left << setw(20) << "case" << right << setw(10) << "iters" << setw(14) << "iters/s"
+         << setw(10) << "ns/visit" << setw(12) << "peak RSS" << setw(16) << "exploitability"
+         << setw(10) << "target" << setw(12) << "to target" << '\n';
+    for (const Case& c : get_cases(n_threads)) {
+        if (c.name.find(filter) == string::npos)
+            continue;
+        Result res = c.run(c);
+
+        ostringstream ns_per_visit, rss, to_target;
+        ns_per_visit << fixed << setprecision(1);
+        if (res.visits > 0)
+            ns_per_visit << res.seconds * 1e9 / res.visits;
+        else
+            ns_per_visit << "-";
+        rss << fixed << setprecision(1) << res.peak_rss_kb / 1024.0 << " MiB";
+        to_target << fixed << setprecision(4);
+        if (res.time_to_target >= 0)
+            to_target << res.time_to_target << " s";
+        else
+            to_target << "-";
+
+        cout << left << setw(20) << c.name << right << setw(10) << res.iterations
+             << setw(14) << fixed << setprecision(0) << res.iterations / res.seconds
+             << setw(10) << ns_per_visit.str() << setw(12) << rss.str()
+             << setw(16) << setprecision(6) << res.exploitability
+             << setw(10) << setprecision(3) << c.target << setw(12) << to_target.str() << endl;
+    }
+}
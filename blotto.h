@@ -0,0 +1,91 @@
+#pragma once
+
+#include "matrix_game.h"
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Colonel Blotto: the pure allocations of S soldiers over N battlefields and their payoff for
+// MatrixGameSolver. The problem statement is in war.cc.
+
+namespace blotto {
+
+// number of battlefields
+const int N = 3;
+// number of soldiers
+const int S = 5;
+
+// Allocations are packed one battlefield per byte into WORDS 64-bit words, so that a pair of
+// allocations can be compared on every battlefield at once. Utilities are computed on the fly
+// from the packed words instead of from an NUM_ACTIONS x NUM_ACTIONS table, so memory grows with
+// the number of actions rather than its square.
+const int WORDS = (N + 7) / 8;
+static_assert(S <= 127, "soldier counts must fit in 7 bits");
+// high bit of every byte
+const uint64_t HIGH_BITS = 0x8080808080808080ULL;
+
+typedef std::array<uint64_t, WORDS> Allocation;
+
+// Append every allocation of s soldiers over battlefields i, ..., N - 1 on top of t to allocations
+inline void add_allocations(Allocation t, int i, int s, std::vector<Allocation>& allocations) {
+    if (i == N - 1) {
+        t[i / 8] |= (uint64_t) s << (8 * (i % 8));
+        allocations.push_back(t);
+        return;
+    }
+    for (int j = 0; j <= s; ++j) {
+        Allocation u = t;
+        u[i / 8] |= (uint64_t) j << (8 * (i % 8));
+        add_allocations(u, i + 1, s - j, allocations);
+    }
+}
+
+inline std::vector<Allocation> get_allocations() {
+    std::vector<Allocation> allocations;
+    add_allocations(Allocation{}, 0, S, allocations);
+    return allocations;
+}
+
+// ACTIONS[i] = allocation whose byte j holds the number of soldiers sent to battlefield j
+const std::vector<Allocation> ACTIONS = get_allocations();
+const int NUM_ACTIONS = ACTIONS.size();
+
+// Returns the number of battlefields where x sends more soldiers than y. Each byte computes
+// (x | 0x80) - y, whose high bit survives exactly when x >= y, with no borrow between bytes.
+inline int count_wins(const Allocation& x, const Allocation& y) {
+    int wins = 0;
+    for (int w = 0; w < WORDS; ++w) {
+        uint64_t x_ge_y = ((x[w] | HIGH_BITS) - y[w]) & HIGH_BITS;
+        uint64_t y_ge_x = ((y[w] | HIGH_BITS) - x[w]) & HIGH_BITS;
+        wins += std::popcount(x_ge_y & ~y_ge_x);
+    }
+    return wins;
+}
+
+// utility from playing action a against action b
+inline int get_utility(int a, int b) {
+    return count_wins(ACTIONS[a], ACTIONS[b]) - count_wins(ACTIONS[b], ACTIONS[a]);
+}
+
+// Returns allocation as its per-battlefield soldier counts, e.g. "023"
+inline std::string to_string(const Allocation& allocation) {
+    std::string res;
+    for (int i = 0; i < N; ++i) {
+        if (S >= 10 && i > 0)
+            res += ',';
+        res += std::to_string((allocation[i / 8] >> (8 * (i % 8))) & 0xff);
+    }
+    return res;
+}
+
+// Payoff for MatrixGameSolver, read straight off the packed allocations
+struct Payoff {
+    double operator()(int a, int b) const { return get_utility(a, b); }
+};
+
+typedef MatrixGameSolver<DYNAMIC_ACTIONS, Payoff> Solver;
+
+}  // namespace blotto
@@ -0,0 +1,1492 @@
+#pragma once
+
+#include "arena.h"
+#include "checkpoint.h"
+#include "cluster.h"
+#include "metrics.h"
+#include "policy.h"
+#include "regret_matching.h"
+#include "rng.h"
+#include "stats.h"
+#include "strategy_file.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Game-agnostic CFR engine for two-player zero-sum games where chance deals each player a
+// private state up front and play is public from then on. A game plugs in through a traits type:
+//
+//   struct Traits {
+//       using Table = ...;                     // the history tree, see below
+//       static constexpr int NUM_ACTIONS;      // width of every strategy row
+//       static constexpr int NUM_PRIVATE;      // private states per player, numbered from 1
+//       static const std::string NAME;         // tag of the game's strategy files
+//       static std::vector<Deal> get_deals();  // every chance outcome
+//       static double get_weight(const Deal&); // relative probability of a chance outcome
+//   };
+//
+// A Deal is a vector where deal[p] is player p's private state. The Table is default
+// constructible and provides, for dense history ids h, which histories that play out alike may
+// share, so that the ids form a graph whose paths are the game tree:
+//
+//   ROOT, get_child(h, a), is_terminal(h), get_player(h), get_n_histories(), get_n_info_sets(),
+//   get_first_action(h), get_last_action(h)  - legal actions are [first, last)
+//   get_info_set(x, h)                       - id of the info set of the player to move holding x
+//   get_utility(h, deal)                     - payoff of terminal h wrt the player to move
+//
+// Everything the solvers share (arena storage, the thread pool, the MCCFR variants, the regret
+// policies, best response, strategy files and checkpoints) lives here once, and each game gets
+// its own instantiation, with every table lookup visible to the compiler.
+
+typedef std::vector<int> Deal;
+
+// Returns x rounded to one of the two neighbouring floats, up with probability proportional to
+// its distance from the one below, so that the rounding error is zero on average. Adding random
+// bits below float precision to the magnitude and truncating them does exactly that.
+inline float round_stochastic(double x, Rng& rng) {
+    const int DROPPED = 52 - 23;
+    const uint64_t LOW = ((uint64_t) 1 << DROPPED) - 1;
+    uint64_t bits = std::bit_cast<uint64_t>(x) + (rng() & LOW);
+    return static_cast<float>(std::bit_cast<double>(bits & ~LOW));
+}
+
+// Add v to x. Float storage is rounded stochastically when rng is set, so that updates far
+// smaller than x still add up to the right sum on average instead of vanishing.
+template <class Real>
+void accumulate(Real& x, double v, Rng* rng) {
+    static_assert(std::is_same_v<Real, double> || std::is_same_v<Real, float>);
+    if constexpr (std::is_same_v<Real, double>)
+        x += v;
+    else if (rng)
+        x = round_stochastic(x + v, *rng);
+    else
+        x += v;
+}
+
+// Multiply x by f, rounding like accumulate
+template <class Real>
+void scale(Real& x, double f, Rng* rng) {
+    if constexpr (std::is_same_v<Real, double>)
+        x *= f;
+    else if (rng)
+        x = round_stochastic(x * f, *rng);
+    else
+        x *= f;
+}
+
+// View of one information set's row in the solver's flat regret/strategy store, held as Real.
+// Regrets are read from regret_sum, while updates go to regret_out and strategy_sum. Those are
+// the solver's own sums, unless a training thread is accumulating into private buffers.
+template <class Real = double>
+class Node {
+private:
+    const Real* regret_sum;
+    Real *regret_out, *strategy_sum;
+    // this iteration's weights on regret and strategy updates, and whether regrets are floored
+    double regret_weight = 1, strategy_weight = 1;
+    bool floor = false;
+    // strategy already computed from regret_sum for this iteration, if any
+    const double* current_strategy = nullptr;
+    // stream for stochastic rounding of the updates, if Real is narrower than double
+    Rng* rng = nullptr;
+    // legal actions are [lo, hi)
+    int lo, hi;
+public:
+    Node(const Real* regret_sum, Real* regret_out, Real* strategy_sum, int lo, int hi) :
+        regret_sum(regret_sum), regret_out(regret_out), strategy_sum(strategy_sum), lo(lo), hi(hi) {}
+
+    // Update strategy using regret matching, using p as the probability
+    // of being in this state. The strategy is written to the caller's buffer.
+    void get_strategy(double p, double* strategy) {
+        double weight = this->strategy_weight * p;
+        if (this->current_strategy) {
+            for (int a = this->lo; a < this->hi; ++a) {
+                strategy[a] = this->current_strategy[a];
+                accumulate(this->strategy_sum[a], weight * strategy[a], this->rng);
+            }
+            return;
+        }
+        if constexpr (std::is_same_v<Real, double>) {
+            regret_matching(this->regret_sum, strategy, this->lo, this->hi, this->strategy_sum,
+                            weight);
+        } else {
+            regret_matching(this->regret_sum, strategy, this->lo, this->hi);
+            if (weight != 0)
+                for (int a = this->lo; a < this->hi; ++a)
+                    accumulate(this->strategy_sum[a], weight * strategy[a], this->rng);
+        }
+    }
+
+    // Update regret value
+    void update_regret(int a, double v) {
+        accumulate(this->regret_out[a], this->regret_weight * v, this->rng);
+        if (this->floor)
+            this->regret_out[a] = std::max<Real>(this->regret_out[a], 0);
+    }
+
+    // Set the update rule for this iteration
+    void set_weights(double regret_weight, double strategy_weight, bool floor) {
+        this->regret_weight = regret_weight;
+        this->strategy_weight = strategy_weight;
+        this->floor = floor;
+    }
+
+    // Use a strategy precomputed for this iteration instead of regret matching on every visit
+    void set_current_strategy(const double* current_strategy) {
+        this->current_strategy = current_strategy;
+    }
+
+    // Round updates stochastically with draws from rng
+    void set_rng(Rng* rng) {
+        this->rng = rng;
+    }
+
+    // Returns whether action a, given this iteration's strategy, can be skipped by regret-based
+    // pruning: it isn't played, its regret is below threshold, and an update of up to max_regret
+    // would leave it unplayed
+    bool is_pruned(int a, const double* strategy, double threshold, double max_regret) const {
+        return strategy[a] == 0 && this->regret_sum[a] < threshold &&
+               this->regret_sum[a] + this->regret_weight * max_regret < 0;
+    }
+
+    // Write computed strategy at this node to average_strategy
+    void get_average_strategy(double* average_strategy) const {
+        double norm = 0;
+        for (int a = this->lo; a < this->hi; ++a)
+            norm += this->strategy_sum[a];
+        for (int a = this->lo; a < this->hi; ++a) {
+            if (norm > 0)
+            average_strategy[a] = this->strategy_sum[a] / norm;
+            else
+            average_strategy[a] = 1.0 / (this->hi - this->lo);
+        }
+    }
+};
+
+// Monte Carlo CFR variants. NONE walks the whole tree for a deal (or for every deal at once, on
+// the public tree); CHANCE samples the deal and walks the whole tree; EXTERNAL samples the deal
+// and every action not taken by the player being updated; OUTCOME samples a single trajectory
+// per update.
+enum class Sampling { NONE, CHANCE, EXTERNAL, OUTCOME };
+
+// Regret and averaging update rules, applied to iteration t. In sequential full-width training an
+// iteration is a single deal, and t counts passes over every deal instead.
+// CFR      - regrets and strategies are summed with equal weight
+// CFR_PLUS - regrets are floored at zero after every update, strategies are weighted by t
+// LINEAR   - regrets and strategies are both weighted by t
+// DCFR     - after iteration t, positive regrets are scaled by t^alpha / (t^alpha + 1), negative
+//            regrets by t^beta / (t^beta + 1), and strategy sums by (t / (t + 1))^gamma
+enum class RegretPolicy { CFR, CFR_PLUS, LINEAR, DCFR };
+
+// exploration probability at the updating player's nodes in outcome sampling
+const double OUTCOME_EXPLORATION = 0.6;
+
+struct SolverOptions {
+    Sampling sampling = Sampling::NONE;
+    // n_threads > 1 selects parallel training: every iteration visits all chance outcomes, or
+    // runs one sampled iteration per thread
+    int n_threads = 1;
+    // seeds the sampling variants, which are then deterministic for a given thread count
+    uint64_t seed = 0;
+    RegretPolicy policy = RegretPolicy::CFR;
+    // DCFR discount parameters
+    double alpha = 1.5, beta = 0, gamma = 2;
+    // with Sampling::NONE, run every iteration as one walk of the public tree that carries all
+    // private states at once, instead of one walk per deal. It runs on the calling thread.
+    bool public_tree = false;
+    // regret-based pruning, if prune_threshold < 0: an action that isn't played, whose regret is
+    // below prune_threshold and would stay negative after the iteration's updates, is not walked.
+    // Its regret grows as if it had been worth the largest payoff, which overstates it but never
+    // understates it, so it is walked again once its true regret might have recovered. Every
+    // prune_interval-th pass still walks the whole tree. Applies to full-width walks and to the
+    // traverser's actions in external sampling; CFR_PLUS floors regrets at zero, so nothing is
+    // ever pruned under it.
+    double prune_threshold = 0;
+    int prune_interval = 20;
+};
+
+// Real is the type the regret and strategy sums are stored in. Traversal arithmetic is always
+// double; float storage halves the tables' memory and bandwidth, and is rounded stochastically
+// so that the sums stay unbiased however long training runs.
+template <class Traits, class Real = double>
+class CfrSolver {
+public:
+    using Table = typename Traits::Table;
+    static constexpr int NUM_ACTIONS = Traits::NUM_ACTIONS;
+    static constexpr int NUM_PRIVATE = Traits::NUM_PRIVATE;
+    // one value per private state x, at index x - 1
+    typedef std::array<double, NUM_PRIVATE> PrivateVector;
+    // Returns the entry of a source solution that action a starts from, at the information set of
+    // the player to move holding x after history h, or -1 to start it from zero
+    typedef std::function<long(int x, int h, int a)> WarmStartMap;
+private:
+    Table table;
+    // block that all regret and strategy storage is carved out of, freed with the solver
+    Arena arena;
+    // struct of arrays: row i * NUM_ACTIONS holds the values of information set i
+    Real *regret_sum, *strategy_sum;
+
+    // destination for the regret and strategy updates of one traversal
+    struct Accumulator {
+        Real *regret_sum, *strategy_sum;
+        // update rule for the current iteration
+        double regret_weight = 1, strategy_weight = 1;
+        bool floor = false;
+        // table of every information set's strategy for this iteration, if precomputed
+        const double* current_strategy = nullptr;
+        // counters of the thread running the traversal
+        Stats* stats = nullptr;
+        // stream of the thread running the traversal, for stochastic rounding
+        Rng* rng = nullptr;
+        // whether this iteration prunes
+        bool prune = false;
+    };
+    // parallel training: per-thread accumulators, merged into the sums after every iteration
+    std::unique_ptr<ThreadPool> pool;
+    Arena scratch;
+    std::vector<Accumulator> accumulators;
+    // every information set's strategy, computed in one batch at the start of a full iteration,
+    // or of a sequential pass whose update rule ends it with a pass over the table
+    double* current_strategy = nullptr;
+    // the sequential pass current_strategy was computed for, or -1
+    long strategy_pass = -1;
+    // legal action range of every information set, for the batched regret matching
+    std::vector<int> row_lo, row_hi;
+    // every chance outcome, for iterations that visit or sample from all of them, with
+    // chance[d] the probability of deal d and deal_scale[d] that over the probability of a
+    // uniformly chosen deal
+    std::vector<Deal> deals;
+    std::vector<double> chance, deal_scale;
+    // cumulative chance probabilities for sampling, empty if every deal is equally likely
+    std::vector<double> chance_cdf;
+    // public tree: terminal_payoffs[(terminal_index[h] * NUM_PRIVATE + x0 - 1) * NUM_PRIVATE +
+    // x1 - 1] is player 1's payoff at terminal history h, summed over the deals giving the
+    // players x0 and x1, deal_weight[(x0 - 1) * NUM_PRIVATE + x1 - 1] the number of those deals
+    // and private_count[p][x - 1] the number of deals giving player p x, all scaled by deal_scale
+    bool public_tree;
+    std::vector<int> terminal_index;
+    std::vector<double> terminal_payoffs, deal_weight;
+    PrivateVector private_count[2] = {};
+
+    Sampling sampling;
+    RegretPolicy policy;
+    double alpha, beta, gamma;
+    double prune_threshold;
+    int prune_interval;
+    // largest payoff any player wins at any terminal history, with pruning: a pruned action's
+    // regret grows as if that were its value, as nothing it could be worth would grow it more
+    double payoff_bound = 0;
+    // with pruning, about how many updates an information set of player p holding x - 1 takes
+    // between two looks at its regrets, at prune_updates[p][x - 1]. An action is only pruned
+    // if that many updates by the payoff bound would still leave it unplayed.
+    PrivateVector prune_updates[2] = {};
+    // number of histories in the subtree rooted at every history, for counting what pruning
+    // skips; only filled in when stats are compiled in
+    std::vector<int> subtree_size;
+    // iterations completed so far
+    long iteration = 0;
+    // one random stream per thread, for the sampling variants, and one for stochastic rounding,
+    // jumped clear of it so that rounding doesn't change what is sampled
+    uint64_t seed;
+    std::vector<Rng> rngs, rounding_rngs;
+    // per thread instrumentation, written to stats_path after every call of train if set
+    std::vector<Stats> stats;
+    std::string stats_path;
+
+    // asynchronous checkpoints every checkpoint_every iterations, if set
+    std::unique_ptr<Checkpointer> checkpointer;
+    int checkpoint_every = 0;
+    // policy snapshots published every publish_every iterations, if set
+    std::shared_ptr<PolicySlot<>> policy_slot;
+    int publish_every = 0;
+    // progress reported to metrics_sink every metrics_every iterations, with the exploitability
+    // every exploitability_every iterations, if set. The window is what the next report covers.
+    std::shared_ptr<MetricsSink> metrics_sink;
+    int metrics_every = 0, exploitability_every = 0;
+    std::chrono::steady_clock::time_point metrics_start, window_start;
+    long window_iteration = 0;
+    double window_utility = 0;
+    uint64_t window_visits = 0;
+    // distributed training: this process trains its rank's share of the deals, and every rank
+    // merges their updates every sync_every iterations. synced_* hold the sums as of the last
+    // merge, and delta_* the updates since, summed over every rank once merging. Merges round
+    // with sync_rng, which every rank draws from alike so that they all round the same way.
+    std::shared_ptr<Cluster> cluster;
+    int sync_every = 0;
+    long synced_iteration = 0;
+    Arena cluster_buffers;
+    Real *synced_regret_sum = nullptr, *synced_strategy_sum = nullptr;
+    Real *delta_regret_sum = nullptr, *delta_strategy_sum = nullptr;
+    Rng sync_rng;
+
+    int get_n_entries() const { return this->table.get_n_info_sets() * NUM_ACTIONS; }
+
+    // Returns the node of the player to move holding x after history h, updating into acc
+    Node<Real> get_node(int x, int h, Accumulator& acc) {
+        ScopedTimer timer(acc.stats, Timer::GET_NODE);
+        acc.stats->add(Counter::NODE_LOOKUPS);
+        int i = this->table.get_info_set(x, h) * NUM_ACTIONS;
+        Node<Real> node(this->regret_sum + i, acc.regret_sum + i, acc.strategy_sum + i,
+                  this->table.get_first_action(h), this->table.get_last_action(h));
+        node.set_weights(acc.regret_weight, acc.strategy_weight, acc.floor);
+        if (acc.current_strategy)
+            node.set_current_strategy(acc.current_strategy + i);
+        if constexpr (!std::is_same_v<Real, double>)
+            node.set_rng(acc.rng);
+        return node;
+    }
+
+    // Fill prune_updates for how this solver trains. Sequential iterations see every update
+    // before the next; threads and ranks only see each other's at the end of an iteration or at
+    // a merge, so an information set may take one from every deal holding its private state, or
+    // from every sampled iteration, before its regrets are looked at again.
+    void set_prune_updates() {
+        double iterations = this->cluster ? this->sync_every : 1;
+        for (int p = 0; p < 2; ++p)
+            this->prune_updates[p].fill(0);
+        for (const Deal& deal : this->deals)
+            for (int p = 0; p < 2; ++p)
+                ++this->prune_updates[p][deal[p] - 1];
+        for (int p = 0; p < 2; ++p)
+            for (double& n : this->prune_updates[p]) {
+                if (this->sampling != Sampling::NONE)
+                    n = (this->pool ? this->pool->size() : 1) *
+                        (this->cluster ? this->cluster->get_n_ranks() : 1);
+                else if (!this->pool && !this->cluster)
+                    n = 1;
+                n *= iterations;
+            }
+    }
+
+    // Count the subtree at history h as skipped by pruning
+    void add_pruned(int h, Accumulator& acc) {
+        acc.stats->add(Counter::PRUNED_SUBTREES);
+        if constexpr (STATS_ENABLED)
+            acc.stats->add(Counter::PRUNED_HISTORIES, this->subtree_size[h]);
+    }
+
+    // Fill subtree_size for h and everything below it. Returns the size of h's subtree, counting
+    // a history shared by several paths once on each.
+    int count_subtree(int h) {
+        if (this->subtree_size[h] != 0)
+            return this->subtree_size[h];
+        int size = 1;
+        if (!this->table.is_terminal(h))
+            for (int a = this->table.get_first_action(h); a < this->table.get_last_action(h); ++a)
+                size += this->count_subtree(this->table.get_child(h, a));
+        return this->subtree_size[h] = size;
+    }
+
+    // Use counterfactual regret minimization to compute utility of node
+    double cfr(const Deal& deal, int h, double p1, double p2, Accumulator& acc) {
+        ScopedTimer timer(acc.stats, Timer::CFR, h == Table::ROOT);
+        acc.stats->add(Counter::NODE_VISITS);
+        // base case: return payoff for terminal state
+        if (this->table.is_terminal(h)) {
+            acc.stats->add(Counter::TERMINAL_EVALUATIONS);
+            return this->table.get_utility(h, deal);
+        }
+
+        int player_idx = this->table.get_player(h);
+        Node<Real> node = this->get_node(deal[player_idx], h, acc);
+
+        // compute reach probability
+        double reach_p = (player_idx == 0) ? p2 : p1;
+        // update current player's strategy, averaged by its own reach
+        double strategy[NUM_ACTIONS];
+        node.get_strategy((player_idx == 0) ? p1 : p2, strategy);
+
+        int lo = this->table.get_first_action(h), hi = this->table.get_last_action(h);
+        double util[NUM_ACTIONS];
+        bool pruned[NUM_ACTIONS] = {};
+        // utility of this node (the eventual return value of the cfr)
+        double node_util = 0;
+
+        // traverse over possible actions
+        for (int a = lo; a < hi; ++a) {
+            int child = this->table.get_child(h, a);
+            // an unplayed action adds nothing to node_util, and nothing below it is reached
+            if (acc.prune &&
+                node.is_pruned(a, strategy, this->prune_threshold,
+                               2 * this->payoff_bound * reach_p *
+                                   this->prune_updates[player_idx][deal[player_idx] - 1])) {
+                pruned[a] = true;
+                this->add_pruned(child, acc);
+                continue;
+            }
+            // player_idx = 0 corresponds to player 1's action
+            if (player_idx == 0)
+                util[a] = -cfr(deal, child, p1 * strategy[a], p2, acc);
+            else
+                util[a] = -cfr(deal, child, p1, p2 * strategy[a], acc);
+
+            // update total node utility
+            node_util += strategy[a] * util[a];
+        }
+
+        // update regret for each action, and for a pruned one by as much as it could have, so
+        // that it is walked again once its true regret might have turned positive
+        for (int a = lo; a < hi; ++a) {
+            double regret = (pruned[a] ? this->payoff_bound : util[a]) - node_util;
+            node.update_regret(a, reach_p * regret);
+        }
+
+        return node_util;
+    }
+
+    // Run cfr on deal d, with its updates and utility scaled by deal_scale[d] so that a pass over
+    // every deal weights each by its chance probability
+    double deal_cfr(int d, Accumulator& acc) {
+        double scale = this->deal_scale[d];
+        if (scale == 1)
+            return cfr(this->deals[d], Table::ROOT, 1, 1, acc);
+        Accumulator weighted = acc;
+        weighted.regret_weight *= scale;
+        weighted.strategy_weight *= scale;
+        return scale * cfr(this->deals[d], Table::ROOT, 1, 1, weighted);
+    }
+
+    // Returns a deal drawn from the chance distribution
+    const Deal& sample_deal(Rng& rng) const {
+        if (this->chance_cdf.empty())
+            return this->deals[rng.below(this->deals.size())];
+        double r = rng.uniform();
+        int d = std::upper_bound(this->chance_cdf.begin(), this->chance_cdf.end(), r) -
+                this->chance_cdf.begin();
+        return this->deals[std::min<int>(d, this->deals.size() - 1)];
+    }
+
+    // Public-tree CFR: walk history h once for every deal, where reach[p][x - 1] is the reach of
+    // player p holding x. Fills value[p][x - 1] with p's counterfactual value of holding x, which
+    // is the sum over deals of what cfr computes for each, and updates every (x, h) info set.
+    void public_cfr(int h, const PrivateVector (&reach)[2], PrivateVector (&value)[2],
+                    Accumulator& acc) {
+        acc.stats->add(Counter::NODE_VISITS);
+        // showdown: the payoff matrix against each player's opponent reach
+        if (this->table.is_terminal(h)) {
+            acc.stats->add(Counter::TERMINAL_EVALUATIONS);
+            const double* payoffs = &this->terminal_payoffs[this->terminal_index[h] *
+                                                             NUM_PRIVATE * NUM_PRIVATE];
+            value[0].fill(0);
+            value[1].fill(0);
+            for (int x0 = 0; x0 < NUM_PRIVATE; ++x0)
+                for (int x1 = 0; x1 < NUM_PRIVATE; ++x1) {
+                    double u = payoffs[x0 * NUM_PRIVATE + x1];
+                    value[0][x0] += u * reach[1][x1];
+                    value[1][x1] -= u * reach[0][x0];
+                }
+            return;
+        }
+
+        int p = this->table.get_player(h), o = 1 - p;
+        int lo = this->table.get_first_action(h), hi = this->table.get_last_action(h);
+        double strategy[NUM_PRIVATE][NUM_ACTIONS];
+        // the most p holding x could win below any action, given o's reach
+        PrivateVector bound_value = {};
+        if (acc.prune)
+            for (int x = 0; x < NUM_PRIVATE; ++x)
+                for (int y = 0; y < NUM_PRIVATE; ++y)
+                    bound_value[x] += this->payoff_bound * reach[o][y] *
+                                      ((p == 0) ? this->deal_weight[x * NUM_PRIVATE + y]
+                                                : this->deal_weight[y * NUM_PRIVATE + x]);
+        // an action is pruned only if it is pruned for every private state
+        bool pruned[NUM_ACTIONS];
+        std::fill(pruned, pruned + NUM_ACTIONS, acc.prune);
+        for (int x = 0; x < NUM_PRIVATE; ++x) {
+            Node<Real> node = this->get_node(x + 1, h, acc);
+            node.get_strategy(reach[p][x] * this->private_count[p][x], strategy[x]);
+            for (int a = lo; a < hi; ++a)
+                pruned[a] = pruned[a] && node.is_pruned(a, strategy[x], this->prune_threshold,
+                                                        2 * bound_value[x]);
+        }
+
+        PrivateVector child_reach[2], child_value[2];
+        double util[NUM_ACTIONS][NUM_PRIVATE];
+        value[0].fill(0);
+        value[1].fill(0);
+        child_reach[o] = reach[o];
+        for (int a = lo; a < hi; ++a) {
+            // p never plays a, so neither player has any value below it, and its regrets grow
+            // by as much as they could have
+            if (pruned[a]) {
+                this->add_pruned(this->table.get_child(h, a), acc);
+                for (int x = 0; x < NUM_PRIVATE; ++x)
+                    util[a][x] = bound_value[x];
+                continue;
+            }
+            for (int x = 0; x < NUM_PRIVATE; ++x)
+                child_reach[p][x] = reach[p][x] * strategy[x][a];
+            this->public_cfr(this->table.get_child(h, a), child_reach, child_value, acc);
+            for (int x = 0; x < NUM_PRIVATE; ++x) {
+                util[a][x] = child_value[p][x];
+                value[p][x] += strategy[x][a] * child_value[p][x];
+                value[o][x] += child_value[o][x];
+            }
+        }
+
+        // the values already carry the opponent's reach, so they are the regrets
+        for (int x = 0; x < NUM_PRIVATE; ++x) {
+            Node<Real> node = this->get_node(x + 1, h, acc);
+            for (int a = lo; a < hi; ++a)
+                node.update_regret(a, util[a][x] - value[p][x]);
+        }
+    }
+
+    // Run public_cfr from the root. Returns player 1's utility summed over every deal.
+    double run_public_iteration(Accumulator& acc) {
+        PrivateVector reach[2], value[2];
+        reach[0].fill(1);
+        reach[1].fill(1);
+        this->public_cfr(Table::ROOT, reach, value, acc);
+
+        double util = 0;
+        for (double v : value[0])
+            util += v;
+        return util;
+    }
+
+    // Sample an action from strategy over [lo, hi)
+    static int sample_action(const double* strategy, int lo, int hi, Rng& rng) {
+        double r = rng.uniform();
+        int a = lo;
+        double cumulative_prob = 0;
+        while (a < hi - 1) {
+            cumulative_prob += strategy[a];
+            if (r < cumulative_prob) break;
+            ++a;
+        }
+        return a;
+    }
+
+    // Returns payoff for terminal history h, wrt player i
+    double get_utility(int h, const Deal& deal, int i) const {
+        double u = this->table.get_utility(h, deal);
+        return (this->table.get_player(h) == i) ? u : -u;
+    }
+
+    // External sampling MCCFR: explore every action of traverser i, sample one action from the
+    // current strategy everywhere else. Returns the sampled utility for i.
+    double external_cfr(const Deal& deal, int h, int i, Rng& rng, Accumulator& acc) {
+        acc.stats->add(Counter::NODE_VISITS);
+        if (this->table.is_terminal(h)) {
+            acc.stats->add(Counter::TERMINAL_EVALUATIONS);
+            return this->get_utility(h, deal, i);
+        }
+
+        int player_idx = this->table.get_player(h);
+        Node<Real> node = this->get_node(deal[player_idx], h, acc);
+        int lo = this->table.get_first_action(h), hi = this->table.get_last_action(h);
+        double strategy[NUM_ACTIONS];
+
+        // opponent node: sample a single action, and add to the opponent's average strategy
+        if (player_idx != i) {
+            node.get_strategy(1, strategy);
+            int a = sample_action(strategy, lo, hi, rng);
+            return external_cfr(deal, this->table.get_child(h, a), i, rng, acc);
+        }
+
+        node.get_strategy(0, strategy);
+        double util[NUM_ACTIONS];
+        bool pruned[NUM_ACTIONS] = {};
+        double node_util = 0;
+        for (int a = lo; a < hi; ++a) {
+            if (acc.prune &&
+                node.is_pruned(a, strategy, this->prune_threshold,
+                               2 * this->payoff_bound * this->prune_updates[i][deal[i] - 1])) {
+                pruned[a] = true;
+                this->add_pruned(this->table.get_child(h, a), acc);
+                continue;
+            }
+            util[a] = external_cfr(deal, this->table.get_child(h, a), i, rng, acc);
+            node_util += strategy[a] * util[a];
+        }
+        for (int a = lo; a < hi; ++a)
+            node.update_regret(a, (pruned[a] ? this->payoff_bound : util[a]) - node_util);
+
+        return node_util;
+    }
+
+    // Outcome sampling MCCFR: follow a single trajectory, exploring at traverser i's nodes with
+    // probability OUTCOME_EXPLORATION. pi_i and pi_o are the players' reach probabilities and s the
+    // probability of sampling this trajectory so far. Returns the sampled utility for i divided
+    // by the probability of sampling the whole trajectory, and sets tail to the probability of
+    // playing the rest of it under the current strategy.
+    double outcome_cfr(const Deal& deal, int h, int i, double pi_i, double pi_o, double s,
+                       double& tail, Rng& rng, Accumulator& acc) {
+        acc.stats->add(Counter::NODE_VISITS);
+        if (this->table.is_terminal(h)) {
+            acc.stats->add(Counter::TERMINAL_EVALUATIONS);
+            tail = 1;
+            return this->get_utility(h, deal, i) / s;
+        }
+
+        int player_idx = this->table.get_player(h);
+        Node<Real> node = this->get_node(deal[player_idx], h, acc);
+        int lo = this->table.get_first_action(h), hi = this->table.get_last_action(h);
+        double strategy[NUM_ACTIONS];
+        // opponent adds its strategy weighted by its reach over the sampling probability
+        node.get_strategy((player_idx == i) ? 0 : pi_o / s, strategy);
+
+        // sampling distribution: epsilon-on-policy for the traverser, on-policy otherwise
+        double probs[NUM_ACTIONS];
+        for (int a = lo; a < hi; ++a)
+            probs[a] = (player_idx == i)
+                ? OUTCOME_EXPLORATION / (hi - lo) + (1 - OUTCOME_EXPLORATION) * strategy[a]
+                : strategy[a];
+        int a = sample_action(probs, lo, hi, rng);
+        int child = this->table.get_child(h, a);
+
+        double util;
+        if (player_idx == i)
+            util = outcome_cfr(deal, child, i, pi_i * strategy[a], pi_o, s * probs[a], tail, rng, acc);
+        else
+            util = outcome_cfr(deal, child, i, pi_i, pi_o * strategy[a], s * probs[a], tail, rng, acc);
+
+        if (player_idx == i) {
+            double w = util * pi_o;
+            for (int b = lo; b < hi; ++b)
+                node.update_regret(b, (b == a) ? w * tail * (1 - strategy[a]) : -w * tail * strategy[a]);
+        }
+        tail *= strategy[a];
+        return util;
+    }
+
+    // Returns the value to player b of best responding to the average strategy after history h.
+    // Every deal in deals gives b the same private state, so b is in one information set per
+    // history; reach[d] is the chance probability of deal d times the opponent's reach.
+    double best_response(int b, int h, const std::vector<const Deal*>& deals,
+                         const std::vector<double>& reach) {
+        if (this->table.is_terminal(h)) {
+            double util = 0;
+            for (int d = 0; d < (int) deals.size(); ++d)
+                util += reach[d] * this->get_utility(h, *deals[d], b);
+            return util;
+        }
+
+        int lo = this->table.get_first_action(h), hi = this->table.get_last_action(h);
+        // b picks the single best action for its information set
+        if (this->table.get_player(h) == b) {
+            double best = -std::numeric_limits<double>::infinity();
+            for (int a = lo; a < hi; ++a)
+                best = std::max(best, this->best_response(b, this->table.get_child(h, a), deals, reach));
+            return best;
+        }
+
+        // the opponent plays its average strategy, which depends on its own private state
+        int o = this->table.get_player(h);
+        std::vector<double> strategies(deals.size() * NUM_ACTIONS);
+        for (int d = 0; d < (int) deals.size(); ++d)
+            this->get_node((*deals[d])[o], h).get_average_strategy(&strategies[d * NUM_ACTIONS]);
+
+        double util = 0;
+        std::vector<double> child_reach(deals.size());
+        for (int a = lo; a < hi; ++a) {
+            for (int d = 0; d < (int) deals.size(); ++d)
+                child_reach[d] = reach[d] * strategies[d * NUM_ACTIONS + a];
+            util += this->best_response(b, this->table.get_child(h, a), deals, child_reach);
+        }
+        return util;
+    }
+
+    // Traverse game tree, returning expected value under the average strategy
+    double compute_terminal_payoffs(const Deal& deal, int h) {
+        ScopedTimer timer(&this->stats[0], Timer::TERMINAL_PAYOFFS, h == Table::ROOT);
+        // base case: return payoff for terminal state
+        if (this->table.is_terminal(h))
+            return this->table.get_utility(h, deal);
+
+        int player_idx = this->table.get_player(h);
+        double strategy[NUM_ACTIONS];
+        this->get_node(deal[player_idx], h).get_average_strategy(strategy);
+        // utility of this node (the eventual return value of the cfr)
+        double node_util = 0;
+
+        // traverse over possible actions
+        int lo = this->table.get_first_action(h), hi = this->table.get_last_action(h);
+        for (int a = lo; a < hi; ++a)
+            node_util += -compute_terminal_payoffs(deal, this->table.get_child(h, a)) * strategy[a];
+
+        return node_util;
+    }
+
+    // Fill average with the normalized strategy_sum of every information set
+    template <class Sum>
+    void get_average_strategy(const Sum* strategy_sum, double* average) const {
+        for (int h = 0; h < this->table.get_n_histories(); ++h) {
+            if (this->table.is_terminal(h))
+                continue;
+            for (int x = 1; x <= Traits::NUM_PRIVATE; ++x) {
+                int i = this->table.get_info_set(x, h) * NUM_ACTIONS;
+                Node<Sum>(nullptr, nullptr, const_cast<Sum*>(strategy_sum) + i,
+                     this->table.get_first_action(h), this->table.get_last_action(h))
+                    .get_average_strategy(average + i);
+            }
+        }
+    }
+
+    // Hand a copy of the training state to the checkpoint writer, if one is due
+    void checkpoint_if_due() {
+        if (!this->checkpointer || this->iteration % this->checkpoint_every != 0)
+            return;
+        StrategyHeader header(Traits::NAME, NUM_ACTIONS, this->table.get_n_info_sets(),
+                              this->iteration);
+        this->checkpointer->save(header, this->regret_sum, this->strategy_sum,
+                                 [this](const double* strategy_sum, double* average) {
+                                     this->get_average_strategy(strategy_sum, average);
+                                 });
+    }
+
+    // Publish a snapshot of the average strategy to the policy slot, if one is due
+    void publish_if_due() {
+        if (this->policy_slot && this->iteration % this->publish_every == 0)
+            this->policy_slot->publish(this->get_policy());
+    }
+
+    // Add util, player 1's utility in the iteration just run, to the window, and push a report
+    // covering the window to the metrics sink if one is due. The exploitability isn't timed.
+    void report_if_due(double util) {
+        if (!this->metrics_sink)
+            return;
+        this->window_utility += util;
+        if (this->iteration % this->metrics_every != 0)
+            return;
+
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - this->window_start).count();
+        long n = this->iteration - this->window_iteration;
+        Metrics m;
+        m.iteration = this->iteration;
+        m.seconds = std::chrono::duration<double>(now - this->metrics_start).count();
+        m.iterations_per_second = n / seconds;
+        m.utility = this->window_utility / n;
+        if constexpr (STATS_ENABLED) {
+            uint64_t visits = this->get_stats().get(Counter::NODE_VISITS);
+            m.nodes_per_second = (visits - this->window_visits) / seconds;
+            this->window_visits = visits;
+        }
+        if (this->exploitability_every > 0 && this->iteration % this->exploitability_every == 0)
+            m.exploitability = this->compute_exploitability();
+        this->metrics_sink->push(m);
+
+        this->window_start = std::chrono::steady_clock::now();
+        this->window_iteration = this->iteration;
+        this->window_utility = 0;
+    }
+
+    // Start every rounding stream 2^128 draws past the sampling stream of its thread
+    void seed_rounding_streams() {
+        for (int t = 0; t < (int) this->rngs.size(); ++t) {
+            this->rounding_rngs[t] = this->rngs[t];
+            this->rounding_rngs[t].jump();
+        }
+    }
+
+    // Returns whether every iteration is a single deal, as in sequential full-width training
+    bool is_per_deal() const {
+        return !this->pool && !this->public_tree && !this->cluster &&
+               this->sampling == Sampling::NONE;
+    }
+
+    // Returns the pass the next iteration belongs to, counting from 0. The update rules and
+    // pruning count passes over every deal, which single-deal iterations take deals.size() of.
+    long get_pass() const {
+        return this->is_per_deal() ? this->iteration / (long) this->deals.size() : this->iteration;
+    }
+
+    // Returns whether the next iteration ends a pass
+    bool ends_pass() const {
+        return !this->is_per_deal() || (this->iteration + 1) % (long) this->deals.size() == 0;
+    }
+
+    // Set acc's update rule for the next iteration. Regrets are only floored in place when acc
+    // writes straight into the solver's sums of a single process and the iteration is a whole
+    // pass; accumulated deltas and single deals are floored once the pass is merged or done.
+    void begin_iteration(Accumulator& acc) {
+        long pass = this->get_pass();
+        double t = pass + 1;
+        bool linear = (this->policy == RegretPolicy::LINEAR);
+        acc.regret_weight = linear ? t : 1;
+        acc.strategy_weight = (linear || this->policy == RegretPolicy::CFR_PLUS) ? t : 1;
+        acc.floor = (this->policy == RegretPolicy::CFR_PLUS && acc.regret_sum == this->regret_sum &&
+                     !this->cluster && !this->is_per_deal());
+        acc.prune = this->prune_threshold < 0 && pass % this->prune_interval != 0;
+    }
+
+    // Returns whether the update rule needs a pass over the whole table after each pass
+    bool needs_end_pass() const {
+        return this->policy == RegretPolicy::DCFR ||
+               (this->policy == RegretPolicy::CFR_PLUS &&
+                (this->pool || this->cluster || this->is_per_deal()));
+    }
+
+    // Apply the end-of-iteration part of the update rule of iteration t, counting from 1, to
+    // entries [first, last), rounding with draws from rng
+    void end_iteration(double t, int first, int last, Rng& rng) {
+        if (this->policy == RegretPolicy::CFR_PLUS)
+            for (int i = first; i < last; ++i)
+                this->regret_sum[i] = std::max<Real>(this->regret_sum[i], 0);
+
+        if (this->policy == RegretPolicy::DCFR) {
+            double positive = std::pow(t, this->alpha) / (std::pow(t, this->alpha) + 1);
+            double negative = std::pow(t, this->beta) / (std::pow(t, this->beta) + 1);
+            double strategy = std::pow(t / (t + 1), this->gamma);
+            for (int i = first; i < last; ++i) {
+                scale(this->regret_sum[i], (this->regret_sum[i] > 0) ? positive : negative, &rng);
+                scale(this->strategy_sum[i], strategy, &rng);
+            }
+        }
+    }
+
+    // Train one iteration into the solver's own sums, with traverse(acc) walking the tree.
+    template <class Traverse>
+    double run_iteration(Traverse traverse) {
+        Accumulator acc = {this->regret_sum, this->strategy_sum};
+        acc.stats = &this->stats[0];
+        acc.rng = &this->rounding_rngs[0];
+        this->begin_iteration(acc);
+        double util = traverse(acc);
+        if (this->needs_end_pass() && this->ends_pass())
+            this->end_iteration(this->get_pass() + 1, 0, this->get_n_entries(),
+                                this->rounding_rngs[0]);
+        ++this->iteration;
+        this->checkpoint_if_due();
+        this->publish_if_due();
+        return util;
+    }
+
+    // Run one sampled iteration into acc. Returns an estimate of player 1's utility.
+    double run_sampled_iteration(Rng& rng, Accumulator& acc) {
+        if (this->sampling == Sampling::CHANCE)
+            return cfr(this->sample_deal(rng), Table::ROOT, 1, 1, acc);
+
+        double util = 0;
+        for (int i = 0; i < 2; ++i) {
+            const Deal& deal = this->sample_deal(rng);
+            double u;
+            if (this->sampling == Sampling::EXTERNAL) {
+                u = external_cfr(deal, Table::ROOT, i, rng, acc);
+            } else {
+                double tail;
+                u = outcome_cfr(deal, Table::ROOT, i, 1, 1, 1, tail, rng, acc) * tail;
+            }
+            if (i == 0)
+                util = u;
+        }
+        return util;
+    }
+
+    // Run one iteration across the pool: every deal, or one sampled iteration per thread. Threads
+    // read the regrets from the start of the iteration and accumulate into their own buffers,
+    // which are then merged in thread order, so the result doesn't depend on scheduling. Returns
+    // the summed root utility.
+    double run_parallel_iteration() {
+        std::vector<double> util(this->pool->size());
+        for (Accumulator& acc : this->accumulators) {
+            this->begin_iteration(acc);
+            acc.current_strategy = nullptr;
+        }
+        // regrets stay fixed for a full iteration, so every strategy is computed once up front
+        if (this->sampling == Sampling::NONE) {
+            this->pool->run([&](int t) {
+                auto [first, last] = this->pool->get_range(t, this->table.get_n_info_sets());
+                regret_matching_rows(this->regret_sum + first * NUM_ACTIONS,
+                                     this->current_strategy + first * NUM_ACTIONS, last - first,
+                                     NUM_ACTIONS, &this->row_lo[first], &this->row_hi[first]);
+            });
+            for (Accumulator& acc : this->accumulators)
+                acc.current_strategy = this->current_strategy;
+        }
+        this->pool->run([&](int t) {
+            if (this->sampling != Sampling::NONE) {
+                util[t] = this->run_sampled_iteration(this->rngs[t], this->accumulators[t]);
+                return;
+            }
+            auto [first, last] = this->pool->get_range(t, this->deals.size());
+            for (int d = first; d < last; ++d)
+                util[t] += this->deal_cfr(d, this->accumulators[t]);
+        });
+
+        int n = this->get_n_entries();
+        this->pool->run([&](int t) {
+            auto [first, last] = this->pool->get_range(t, n);
+            for (Accumulator& acc : this->accumulators)
+                for (int i = first; i < last; ++i) {
+                    accumulate(this->regret_sum[i], acc.regret_sum[i], &this->rounding_rngs[t]);
+                    accumulate(this->strategy_sum[i], acc.strategy_sum[i],
+                               &this->rounding_rngs[t]);
+                    acc.regret_sum[i] = acc.strategy_sum[i] = 0;
+                }
+            if (this->needs_end_pass())
+                this->end_iteration(this->iteration + 1, first, last, this->rounding_rngs[t]);
+        });
+        ++this->iteration;
+        this->checkpoint_if_due();
+        this->publish_if_due();
+
+        double total = 0;
+        for (double u : util)
+            total += u;
+        return total;
+    }
+
+    // Merge the updates every rank made since the last merge into the sums as they were then,
+    // and apply the end-of-iteration part of the update rule of every iteration since, leaving
+    // every rank with the same sums
+    void sync() {
+        int n = this->get_n_entries();
+        for (int i = 0; i < n; ++i) {
+            this->delta_regret_sum[i] = this->regret_sum[i] - this->synced_regret_sum[i];
+            this->delta_strategy_sum[i] = this->strategy_sum[i] - this->synced_strategy_sum[i];
+        }
+        this->cluster->all_reduce(this->delta_regret_sum, n);
+        this->cluster->all_reduce(this->delta_strategy_sum, n);
+        for (int i = 0; i < n; ++i) {
+            this->regret_sum[i] = this->synced_regret_sum[i];
+            this->strategy_sum[i] = this->synced_strategy_sum[i];
+            accumulate(this->regret_sum[i], this->delta_regret_sum[i], &this->sync_rng);
+            accumulate(this->strategy_sum[i], this->delta_strategy_sum[i], &this->sync_rng);
+        }
+        if (this->needs_end_pass())
+            for (long t = this->synced_iteration + 1; t <= this->iteration; ++t)
+                this->end_iteration(t, 0, n, this->sync_rng);
+        std::copy(this->regret_sum, this->regret_sum + n, this->synced_regret_sum);
+        std::copy(this->strategy_sum, this->strategy_sum + n, this->synced_strategy_sum);
+        this->synced_iteration = this->iteration;
+    }
+
+    // Run one iteration of this rank's share of the work into the solver's own sums: its deals,
+    // or one sampled iteration. The ranks merge once sync_every iterations have run since they
+    // last did, or if last is set. Returns the summed root utility.
+    double run_distributed_iteration(bool last) {
+        Accumulator acc = {this->regret_sum, this->strategy_sum};
+        acc.stats = &this->stats[0];
+        acc.rng = &this->rounding_rngs[0];
+        this->begin_iteration(acc);
+        double util = 0;
+        if (this->sampling != Sampling::NONE)
+            util = this->run_sampled_iteration(this->rngs[0], acc);
+        else
+            for (int d = this->cluster->get_rank(); d < (int) this->deals.size();
+                 d += this->cluster->get_n_ranks())
+                util += this->deal_cfr(d, acc);
+        ++this->iteration;
+        if (last || this->iteration - this->synced_iteration >= this->sync_every)
+            this->sync();
+        // between merges the sums only hold this rank's updates
+        if (this->iteration == this->synced_iteration) {
+            this->checkpoint_if_due();
+            this->publish_if_due();
+        }
+        return util;
+    }
+
+    // Run T training iterations, across the cluster, on the pool, the public tree, sampled or one
+    // deal at a time
+    double run_training(int T) {
+        double util = 0;
+        if (this->cluster) {
+            int rank = this->cluster->get_rank(), n_ranks = this->cluster->get_n_ranks();
+            // what this rank's iterations cover, and what every rank's together do
+            int n = 1, n_total = n_ranks;
+            if (this->sampling == Sampling::NONE) {
+                n = (this->deals.size() - rank + n_ranks - 1) / n_ranks;
+                n_total = this->deals.size();
+            }
+            for (int i = 0; i < T; ++i) {
+                double u = this->run_distributed_iteration(i == T - 1);
+                util += u;
+                // this rank's own estimate, as the others' utilities aren't merged until the end
+                this->report_if_due(u / n);
+            }
+            this->cluster->all_reduce(&util, 1);
+            return util / n_total / T;
+        }
+
+        if (this->pool) {
+            int n = (this->sampling == Sampling::NONE) ? this->deals.size() : this->pool->size();
+            for (int i = 0; i < T; ++i) {
+                double u = this->run_parallel_iteration() / n;
+                util += u;
+                this->report_if_due(u);
+            }
+            return util / T;
+        }
+
+        if (this->public_tree) {
+            for (int i = 0; i < T; ++i) {
+                double u = this->run_iteration([&](Accumulator& acc) {
+                    return this->run_public_iteration(acc);
+                }) / this->deals.size();
+                util += u;
+                this->report_if_due(u);
+            }
+            return util / T;
+        }
+
+        if (this->sampling != Sampling::NONE) {
+            for (int i = 0; i < T; ++i) {
+                double u = this->run_iteration([&](Accumulator& acc) {
+                    return this->run_sampled_iteration(this->rngs[0], acc);
+                });
+                util += u;
+                this->report_if_due(u);
+            }
+            return util / T;
+        }
+
+        // the first call makes one extra pass over the deals to guarantee that we cover all
+        // possible states at least once, and every iteration moves on to the next deal. CFR+ and
+        // DCFR floor and discount once a pass, so the deals of a pass all play the strategy from
+        // its start, as one full-width iteration would; the other rules play on the regrets as
+        // every deal leaves them.
+        int extra = (this->iteration == 0) ? this->deals.size() : 0;
+        for (int i = 0; i < T + extra; ++i) {
+            int d = this->iteration % this->deals.size();
+            bool fixed = this->needs_end_pass();
+            if (fixed && this->strategy_pass != this->get_pass()) {
+                regret_matching_rows(this->regret_sum, this->current_strategy,
+                                     this->table.get_n_info_sets(), NUM_ACTIONS,
+                                     this->row_lo.data(), this->row_hi.data());
+                this->strategy_pass = this->get_pass();
+            }
+            double u = this->run_iteration([&](Accumulator& acc) {
+                if (fixed)
+                    acc.current_strategy = this->current_strategy;
+                return this->deal_cfr(d, acc);
+            });
+            util += u;
+            this->report_if_due(u);
+        }
+        return util / (T + extra);
+    }
+public:
+    explicit CfrSolver(SolverOptions options = {}) :
+        arena(2 * Arena::footprint<Real>(this->get_n_entries())),
+        public_tree(options.public_tree && options.sampling == Sampling::NONE),
+        sampling(options.sampling), policy(options.policy),
+        alpha(options.alpha), beta(options.beta), gamma(options.gamma),
+        prune_threshold(options.prune_threshold), prune_interval(options.prune_interval),
+        seed(options.seed) {
+        if (this->prune_interval < 1)
+            throw std::runtime_error("prune interval must be at least 1");
+        // pruning takes a negative threshold, and 0 turns it off
+        if (!(this->prune_threshold <= 0))
+            throw std::runtime_error("prune threshold must be negative, or 0 for no pruning");
+        int n_threads = options.n_threads;
+        int n = this->get_n_entries();
+        this->regret_sum = this->arena.allocate<Real>(n);
+        this->strategy_sum = this->arena.allocate<Real>(n);
+
+        if (n_threads > 1 && !this->public_tree) {
+            this->pool = std::make_unique<ThreadPool>(n_threads);
+            this->scratch = Arena(2 * n_threads * Arena::footprint<Real>(n) +
+                                  Arena::footprint<double>(n));
+            this->current_strategy = this->scratch.allocate<double>(n);
+            for (int t = 0; t < n_threads; ++t)
+                this->accumulators.push_back({this->scratch.allocate<Real>(n),
+                                              this->scratch.allocate<Real>(n)});
+        } else if (!this->public_tree && this->sampling == Sampling::NONE &&
+                   (this->policy == RegretPolicy::CFR_PLUS || this->policy == RegretPolicy::DCFR)) {
+            this->scratch = Arena(Arena::footprint<double>(n));
+            this->current_strategy = this->scratch.allocate<double>(n);
+        }
+        for (int t = 0; t < std::max(n_threads, 1); ++t)
+            this->rngs.emplace_back(this->seed + t);
+        this->rounding_rngs.resize(this->rngs.size());
+        this->seed_rounding_streams();
+        this->stats.resize(std::max(n_threads, 1));
+        for (int t = 0; t < (int) this->accumulators.size(); ++t) {
+            this->accumulators[t].stats = &this->stats[t];
+            this->accumulators[t].rng = &this->rounding_rngs[t];
+        }
+        this->deals = Traits::get_deals();
+        double total = 0;
+        bool uniform = true;
+        for (const Deal& deal : this->deals) {
+            total += Traits::get_weight(deal);
+            uniform = uniform && Traits::get_weight(deal) == Traits::get_weight(this->deals[0]);
+        }
+        double cumulative = 0;
+        for (const Deal& deal : this->deals) {
+            this->chance.push_back(Traits::get_weight(deal) / total);
+            this->deal_scale.push_back(Traits::get_weight(deal) * this->deals.size() / total);
+            cumulative += this->chance.back();
+            if (!uniform)
+                this->chance_cdf.push_back(cumulative);
+        }
+
+        if constexpr (STATS_ENABLED) {
+            this->subtree_size.resize(this->table.get_n_histories());
+            this->count_subtree(Table::ROOT);
+        }
+
+        this->row_lo.resize(this->table.get_n_info_sets());
+        this->row_hi.resize(this->table.get_n_info_sets());
+        for (int h = 0; h < this->table.get_n_histories(); ++h)
+            if (!this->table.is_terminal(h))
+                for (int x = 1; x <= Traits::NUM_PRIVATE; ++x) {
+                    this->row_lo[this->table.get_info_set(x, h)] = this->table.get_first_action(h);
+                    this->row_hi[this->table.get_info_set(x, h)] = this->table.get_last_action(h);
+                }
+
+        if (this->public_tree) {
+            this->terminal_index.assign(this->table.get_n_histories(), -1);
+            int n_terminals = 0;
+            for (int h = 0; h < this->table.get_n_histories(); ++h) {
+                if (!this->table.is_terminal(h))
+                    continue;
+                this->terminal_index[h] = n_terminals++;
+                this->terminal_payoffs.resize(n_terminals * NUM_PRIVATE * NUM_PRIVATE);
+                double* payoffs = &this->terminal_payoffs[this->terminal_index[h] *
+                                                          NUM_PRIVATE * NUM_PRIVATE];
+                for (int d = 0; d < (int) this->deals.size(); ++d) {
+                    const Deal& deal = this->deals[d];
+                    payoffs[(deal[0] - 1) * NUM_PRIVATE + deal[1] - 1] +=
+                        this->deal_scale[d] * this->get_utility(h, deal, 0);
+                }
+            }
+            this->deal_weight.assign(NUM_PRIVATE * NUM_PRIVATE, 0);
+            for (int d = 0; d < (int) this->deals.size(); ++d) {
+                const Deal& deal = this->deals[d];
+                this->deal_weight[(deal[0] - 1) * NUM_PRIVATE + deal[1] - 1] += this->deal_scale[d];
+                for (int p = 0; p < 2; ++p)
+                    this->private_count[p][deal[p] - 1] += this->deal_scale[d];
+            }
+        }
+
+        if (this->prune_threshold < 0)
+            for (int h = 0; h < this->table.get_n_histories(); ++h)
+                if (this->table.is_terminal(h))
+                    for (const Deal& deal : this->deals)
+                        this->payoff_bound = std::max(this->payoff_bound,
+                                                      std::abs(this->get_utility(h, deal, 0)));
+        this->set_prune_updates();
+    }
+
+    // in-flight checkpoints normalize through a pointer to the solver, so it stays put
+    CfrSolver(const CfrSolver&) = delete;
+    CfrSolver& operator=(const CfrSolver&) = delete;
+    CfrSolver(CfrSolver&&) = delete;
+    CfrSolver& operator=(CfrSolver&&) = delete;
+
+    // Zero all regrets and strategy sums and reseed the sampling streams, so the solver can be
+    // retrained without reallocating and trains as a fresh one with its seed would
+    void reset() {
+        this->arena.clear();
+        this->scratch.clear();
+        this->cluster_buffers.clear();
+        this->iteration = this->synced_iteration = 0;
+        this->strategy_pass = -1;
+        for (int t = 0; t < (int) this->rngs.size(); ++t)
+            this->rngs[t].seed(this->seed + t);
+        this->seed_rounding_streams();
+        std::fill(this->stats.begin(), this->stats.end(), Stats());
+    }
+
+    // Train cfr algorithm. Returns the average root utility to player 1 over the T iterations.
+    // In parallel and public-tree mode each iteration visits every deal; in parallel sampled
+    // mode it runs one sampled iteration per thread. With a stats file set, the instrumentation
+    // collected so far is written to it afterwards.
+    double train(int T) {
+        double util = this->run_training(T);
+        if (STATS_ENABLED && !this->stats_path.empty()) {
+            std::ofstream out(this->stats_path);
+            this->write_stats(out);
+        }
+        return util;
+    }
+
+    // Return expected game value
+    double compute_expected_value() {
+        double EV = 0;
+        // average over every chance outcome
+        for (int d = 0; d < (int) this->deals.size(); ++d)
+            EV += compute_terminal_payoffs(this->deals[d], Table::ROOT) * this->chance[d];
+        return EV;
+    }
+
+    // Returns the exploitability of the average strategy: the mean of what each player gains by
+    // best responding to the other. It is zero exactly at a Nash equilibrium.
+    double compute_exploitability() {
+        double br = 0;
+        for (int b = 0; b < 2; ++b)
+            for (int x = 1; x <= Traits::NUM_PRIVATE; ++x) {
+                std::vector<const Deal*> deals;
+                std::vector<double> reach;
+                for (int d = 0; d < (int) this->deals.size(); ++d)
+                    if (this->deals[d][b] == x) {
+                        deals.push_back(&this->deals[d]);
+                        reach.push_back(this->chance[d]);
+                    }
+                br += this->best_response(b, Table::ROOT, deals, reach);
+            }
+        return br / 2;
+    }
+
+    // Train until the exploitability, checked every check_every iterations, drops below epsilon
+    // or max_iterations have run. Returns the final exploitability.
+    double train_until(double epsilon, int check_every = 1000, long max_iterations = LONG_MAX) {
+        long start = this->iteration;
+        double exploitability = this->compute_exploitability();
+        while (exploitability >= epsilon && this->iteration - start < max_iterations) {
+            this->train(std::min<long>(check_every, max_iterations - (this->iteration - start)));
+            exploitability = this->compute_exploitability();
+        }
+        return exploitability;
+    }
+
+    // Write a checkpoint to path every `every` iterations, on a background thread
+    void set_checkpoint(const std::string& path, int every) {
+        if (every < 1)
+            throw std::runtime_error("checkpoint interval must be at least 1");
+        if (this->cluster && every % this->sync_every != 0)
+            throw std::runtime_error("checkpoint interval must be a multiple of the sync interval");
+        this->checkpointer = std::make_unique<Checkpointer>(path);
+        this->checkpoint_every = every;
+    }
+
+    // Publish a snapshot of the average strategy to slot every `every` iterations, on the
+    // training thread. Games reading the slot keep the snapshot they took until they take again.
+    void set_publish(std::shared_ptr<PolicySlot<>> slot, int every) {
+        if (every < 1)
+            throw std::runtime_error("publish interval must be at least 1");
+        if (this->cluster && every % this->sync_every != 0)
+            throw std::runtime_error("publish interval must be a multiple of the sync interval");
+        this->policy_slot = std::move(slot);
+        this->publish_every = every;
+    }
+
+    // Train as rank cluster->get_rank() of cluster, every rank of which must train the same game
+    // with the same options. Each rank walks its share of the deals each iteration, or runs its
+    // own sampled iterations, and every sync_every iterations and at the end of every call of
+    // train the ranks merge their updates. In between, each rank's strategies only see its own
+    // updates, so a longer interval means less communication but staler strategies. Every rank
+    // starts from rank 0's sums and iteration count, so only rank 0 need resume or warm start,
+    // first. Each rank runs its share on the calling thread, so it can't be combined with
+    // n_threads or the public tree. Checkpoints and snapshots are taken right after a merge,
+    // when every rank's sums match, so their intervals must be multiples of sync_every.
+    void set_cluster(std::shared_ptr<Cluster> cluster, int sync_every) {
+        if (sync_every < 1)
+            throw std::runtime_error("sync interval must be at least 1");
+        if (this->pool || this->public_tree)
+            throw std::runtime_error("distributed training runs on one thread per rank");
+        if (this->sampling == Sampling::NONE && cluster->get_n_ranks() > (int) this->deals.size())
+            throw std::runtime_error("the cluster has more ranks than there are deals");
+        // checkpoints and snapshots are only taken right after a merge, when they hold every
+        // rank's updates
+        if (this->checkpointer && this->checkpoint_every % sync_every != 0)
+            throw std::runtime_error("checkpoint interval must be a multiple of the sync interval");
+        if (this->policy_slot && this->publish_every % sync_every != 0)
+            throw std::runtime_error("publish interval must be a multiple of the sync interval");
+
+        // every rank must agree on the game, the storage of its sums and its update rule, down
+        // to the bits of the parameters, and every rank hears if any one doesn't
+        std::array<int64_t, 12> config = {
+            NUM_ACTIONS, this->table.get_n_info_sets(), (int64_t) this->deals.size(),
+            sizeof(Real), sync_every, (int64_t) this->sampling, (int64_t) this->policy,
+            std::bit_cast<int64_t>(this->alpha), std::bit_cast<int64_t>(this->beta),
+            std::bit_cast<int64_t>(this->gamma), std::bit_cast<int64_t>(this->prune_threshold),
+            this->prune_interval};
+        std::array<int64_t, 12> own = config;
+        cluster->broadcast(config.data(), sizeof(config));
+        int64_t n_different = (config != own);
+        cluster->all_reduce(&n_different, 1);
+        if (n_different > 0)
+            throw std::runtime_error(std::to_string(n_different) + " of the cluster's ranks " +
+                                     "train a different game or with other options than rank 0");
+
+        int n = this->get_n_entries();
+        cluster->broadcast(&this->iteration, sizeof(this->iteration));
+        cluster->broadcast(this->regret_sum, n * sizeof(Real));
+        cluster->broadcast(this->strategy_sum, n * sizeof(Real));
+        this->synced_iteration = this->iteration;
+        this->cluster_buffers = Arena(4 * Arena::footprint<Real>(n));
+        this->synced_regret_sum = this->cluster_buffers.allocate<Real>(n);
+        this->synced_strategy_sum = this->cluster_buffers.allocate<Real>(n);
+        this->delta_regret_sum = this->cluster_buffers.allocate<Real>(n);
+        this->delta_strategy_sum = this->cluster_buffers.allocate<Real>(n);
+        std::copy(this->regret_sum, this->regret_sum + n, this->synced_regret_sum);
+        std::copy(this->strategy_sum, this->strategy_sum + n, this->synced_strategy_sum);
+
+        // ranks sample like the threads of a pool, and all round merges with one stream
+        this->rngs[0].seed(this->seed + cluster->get_rank() +
+                           this->iteration * cluster->get_n_ranks());
+        this->seed_rounding_streams();
+        this->sync_rng.seed(this->seed + this->iteration);
+        this->sync_rng.jump();
+        this->sync_rng.jump();
+        this->cluster = std::move(cluster);
+        this->sync_every = sync_every;
+        this->set_prune_updates();
+    }
+
+    // Push a progress report to sink every `every` iterations, and compute the exploitability
+    // for every exploitability_every-th iteration's report if it is positive. Only the pushes
+    // happen on the training thread; the sink formats and writes them on its own.
+    void set_metrics(std::shared_ptr<MetricsSink> sink, int every, int exploitability_every = 0) {
+        if (every < 1)
+            throw std::runtime_error("metrics interval must be at least 1");
+        this->metrics_sink = std::move(sink);
+        this->metrics_every = every;
+        this->exploitability_every = exploitability_every;
+        this->metrics_start = this->window_start = std::chrono::steady_clock::now();
+        this->window_iteration = this->iteration;
+        this->window_utility = 0;
+        this->window_visits = this->get_stats().get(Counter::NODE_VISITS);
+    }
+
+    // Returns an immutable snapshot of the average strategy, to share between any number of
+    // games and threads
+    template <class Entry = double>
+    std::shared_ptr<const BasicPolicy<Entry>> get_policy() const {
+        std::vector<double> average_strategy(this->get_n_entries());
+        this->get_average_strategy(this->strategy_sum, average_strategy.data());
+        return std::make_shared<const BasicPolicy<Entry>>(average_strategy.data(),
+                                                          this->table.get_n_info_sets(),
+                                                          NUM_ACTIONS);
+    }
+
+    // Write the instrumentation to path as JSON after every call of train. This only has an effect
+    // when the counters are compiled in, see stats.h.
+    void set_stats_file(const std::string& path) {
+        this->stats_path = path;
+    }
+
+    // Returns the instrumentation summed over every thread
+    Stats get_stats() const {
+        Stats total;
+        for (const Stats& s : this->stats)
+            total += s;
+        return total;
+    }
+
+    // Write the tree size and the instrumentation summed over every thread as a JSON object
+    void write_stats(std::ostream& out) const {
+        int n_info_sets = this->table.get_n_info_sets();
+        double bytes = this->arena.get_capacity() + this->scratch.get_capacity();
+        out << "{\"game\": \"" << Traits::NAME << "\", \"iterations\": " << this->iteration
+            << ", \"histories\": " << this->table.get_n_histories()
+            << ", \"info_sets\": " << n_info_sets
+            << ", \"bytes_per_info_set\": " << ((n_info_sets > 0) ? bytes / n_info_sets : 0)
+            << ", ";
+        this->get_stats().write_json(out);
+        out << "}\n";
+    }
+
+    // Write the average strategy and training state to path. Strategy files hold doubles, so
+    // solvers of any storage type can resume from each other's files.
+    void save(const std::string& path) const {
+        // a background checkpoint may be writing the same file
+        if (this->checkpointer)
+            this->checkpointer->wait();
+        int n = this->get_n_entries();
+        std::vector<double> average_strategy(n);
+        this->get_average_strategy(this->strategy_sum, average_strategy.data());
+
+        StrategyHeader header(Traits::NAME, NUM_ACTIONS, this->table.get_n_info_sets(),
+                              this->iteration);
+        if constexpr (std::is_same_v<Real, double>) {
+            write_strategy_file(path, header, average_strategy.data(), this->regret_sum,
+                                this->strategy_sum);
+        } else {
+            std::vector<double> regret_sum(this->regret_sum, this->regret_sum + n);
+            std::vector<double> strategy_sum(this->strategy_sum, this->strategy_sum + n);
+            write_strategy_file(path, header, average_strategy.data(), regret_sum.data(),
+                                strategy_sum.data());
+        }
+    }
+
+    // Map the strategy file at path, checking that it was written for this game
+    StrategyImage load(const std::string& path) const {
+        return StrategyImage(path, Traits::NAME, NUM_ACTIONS, this->table.get_n_info_sets());
+    }
+
+    // Continue training from the state saved in image. The sampling streams are reseeded from
+    // the seed and the restored iteration, so a resumed run is reproducible too.
+    void resume(const StrategyImage& image) {
+        int n = this->get_n_entries();
+        std::copy(image.get_regret_sum(), image.get_regret_sum() + n, this->regret_sum);
+        std::copy(image.get_strategy_sum(), image.get_strategy_sum() + n, this->strategy_sum);
+        this->iteration = image.get_header().iteration;
+        // a run resumed mid-pass plays the rest of it from the restored regrets
+        this->strategy_pass = -1;
+        for (int t = 0; t < (int) this->rngs.size(); ++t)
+            this->rngs[t].seed(this->seed + t + this->iteration * this->rngs.size());
+        this->seed_rounding_streams();
+    }
+
+    // Start from source, the solution of an abstraction of this game, instead of from zero. The
+    // source's average strategy, carried over by map, is played for weight passes over every
+    // deal, and the regret and strategy sums become what those passes add: regret matching then
+    // picks up from the source strategy where it holds in this game and moves off it where it
+    // doesn't. Information sets that map finds no source strategy for play uniformly. With
+    // imperfect recall, an information set reached by several histories takes the strategy of
+    // the last one. The iteration count is left as it is. It suits RegretPolicy::CFR, which
+    // weights every iteration alike; the other policies soon outweigh or floor away the start.
+    void warm_start(const StrategyImage& source, const WarmStartMap& map, double weight = 1) {
+        const StrategyHeader& header = source.get_header();
+        long n_source = header.n_info_sets * header.n_actions;
+        std::vector<double> strategy(this->get_n_entries());
+        for (int h = 0; h < this->table.get_n_histories(); ++h) {
+            if (this->table.is_terminal(h))
+                continue;
+            int lo = this->table.get_first_action(h), hi = this->table.get_last_action(h);
+            for (int x = 1; x <= NUM_PRIVATE; ++x) {
+                double* row = &strategy[this->table.get_info_set(x, h) * NUM_ACTIONS];
+                double norm = 0;
+                for (int a = lo; a < hi; ++a) {
+                    long e = map(x, h, a);
+                    if (e >= n_source)
+                        throw std::runtime_error("warm start map is outside " + header.get_game());
+                    row[a] = (e < 0) ? 0 : source.get_strategy_sum()[e];
+                    norm += row[a];
+                }
+                for (int a = lo; a < hi; ++a)
+                    row[a] = (norm > 0) ? row[a] / norm : 1.0 / (hi - lo);
+            }
+        }
+
+        std::fill(this->regret_sum, this->regret_sum + this->get_n_entries(), 0);
+        std::fill(this->strategy_sum, this->strategy_sum + this->get_n_entries(), 0);
+        Accumulator acc = {this->regret_sum, this->strategy_sum};
+        acc.regret_weight = acc.strategy_weight = weight;
+        acc.floor = (this->policy == RegretPolicy::CFR_PLUS);
+        acc.current_strategy = strategy.data();
+        acc.stats = &this->stats[0];
+        acc.rng = &this->rounding_rngs[0];
+        for (int d = 0; d < (int) this->deals.size(); ++d)
+            this->deal_cfr(d, acc);
+        this->strategy_pass = -1;
+    }
+
+    long get_iteration() const {
+        return this->iteration;
+    }
+
+    // Returns the node of the player to move holding x after history h
+    Node<Real> get_node(int x, int h) {
+        int i = this->table.get_info_set(x, h) * NUM_ACTIONS;
+        return Node<Real>(this->regret_sum + i, this->regret_sum + i, this->strategy_sum + i,
+                    this->table.get_first_action(h), this->table.get_last_action(h));
+    }
+
+    const Table& get_table() const {
+        return this->table;
+    }
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "strategy_file.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes training checkpoints to a strategy file on a background thread. save() only copies the
+// sums and returns; the average strategy is computed and the file written off the training
+// thread. If the previous checkpoint is still being written, the new one is skipped rather than
+// stalling training.
+class Checkpointer {
+public:
+    // Fills average (n_info_sets * n_actions) from a snapshot of the strategy sums
+    using Normalizer = std::function<void(const double* strategy_sum, double* average)>;
+private:
+    std::string path;
+    StrategyHeader header;
+    std::vector<double> regret_sum, strategy_sum, average;
+    Normalizer normalize;
+
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool pending = false, stopping = false;
+
+    void write() {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        while (true) {
+            this->changed.wait(lock, [&] { return this->pending || this->stopping; });
+            if (!this->pending)
+                return;
+
+            // the buffers are ours until pending is cleared
+            lock.unlock();
+            try {
+                this->normalize(this->strategy_sum.data(), this->average.data());
+                write_strategy_file(this->path, this->header, this->average.data(),
+                                    this->regret_sum.data(), this->strategy_sum.data());
+            } catch (const std::runtime_error& e) {
+                // a failed checkpoint must not take the training run down with it
+                std::cerr << "checkpoint failed: " << e.what() << '\n';
+            }
+            lock.lock();
+
+            this->pending = false;
+            this->changed.notify_all();
+        }
+    }
+public:
+    explicit Checkpointer(const std::string& path) : path(path) {
+        this->writer = std::thread(&Checkpointer::write, this);
+    }
+
+    Checkpointer(const Checkpointer&) = delete;
+    Checkpointer& operator=(const Checkpointer&) = delete;
+
+    // Finishes writing any pending checkpoint
+    ~Checkpointer() {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->changed.notify_all();
+        this->writer.join();
+    }
+
+    const std::string& get_path() const { return this->path; }
+
+    // Queue a checkpoint of the given sums, which are written as double whatever type Real they
+    // are held in. Returns false if one is already being written.
+    template <class Real>
+    bool save(const StrategyHeader& header, const Real* regret_sum, const Real* strategy_sum,
+              Normalizer normalize) {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->pending)
+            return false;
+
+        std::size_t n = header.n_info_sets * header.n_actions;
+        this->header = header;
+        this->regret_sum.assign(regret_sum, regret_sum + n);
+        this->strategy_sum.assign(strategy_sum, strategy_sum + n);
+        this->average.resize(n);
+        this->normalize = std::move(normalize);
+        this->pending = true;
+        this->changed.notify_all();
+        return true;
+    }
+
+    // Block until the last queued checkpoint is on disk
+    void wait() {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->changed.wait(lock, [&] { return !this->pending; });
+    }
+};
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Processes, on one machine or several, training one solve together over TCP. Rank 0 listens and
+// every other rank connects to it, so the cluster is a star: a reduction gathers every rank's
+// buffer at rank 0, sums it there in rank order and sends the sum back, which makes the result
+// the same whatever order the messages arrive in. Buffers go over the wire as they are laid out
+// in memory, so every rank must run on the same architecture.
+class Cluster {
+private:
+    // how long a connecting rank keeps retrying for rank 0 to listen
+    static constexpr std::chrono::seconds CONNECT_TIMEOUT{60};
+
+    int rank, n_ranks;
+    // on rank 0, the connection to rank r at index r - 1; on every other rank, the one to rank 0
+    std::vector<int> sockets;
+
+    static void send_all(int fd, const void* data, std::size_t n) {
+        const char* p = static_cast<const char*>(data);
+        while (n > 0) {
+            ssize_t sent = send(fd, p, n, MSG_NOSIGNAL);
+            if (sent <= 0)
+                throw std::runtime_error("lost connection to a cluster rank.");
+            p += sent;
+            n -= sent;
+        }
+    }
+
+    static void receive_all(int fd, void* data, std::size_t n) {
+        char* p = static_cast<char*>(data);
+        while (n > 0) {
+            ssize_t received = recv(fd, p, n, 0);
+            if (received <= 0)
+                throw std::runtime_error("lost connection to a cluster rank.");
+            p += received;
+            n -= received;
+        }
+    }
+
+    // Returns the addresses of host and port, which the caller frees with freeaddrinfo
+    static addrinfo* resolve(const std::string& host, int port, bool passive) {
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = passive ? AI_PASSIVE : 0;
+        addrinfo* addresses;
+        if (getaddrinfo(passive ? nullptr : host.c_str(), std::to_string(port).c_str(), &hints,
+                        &addresses) != 0)
+            throw std::runtime_error("could not resolve " + host + ".");
+        return addresses;
+    }
+
+    // Reductions are a few large buffers, and the start-up messages a few small ones that
+    // shouldn't wait on Nagle
+    static void set_no_delay(int fd) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    // Listen on port and accept every other rank, each of which sends its rank first
+    void accept_ranks(int port) {
+        addrinfo* addresses = resolve("", port, true);
+        int listener = socket(addresses->ai_family, addresses->ai_socktype,
+                              addresses->ai_protocol);
+        int one = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        bool bound = listener != -1 &&
+                     bind(listener, addresses->ai_addr, addresses->ai_addrlen) == 0 &&
+                     listen(listener, this->n_ranks) == 0;
+        freeaddrinfo(addresses);
+        if (!bound) {
+            if (listener != -1)
+                close(listener);
+            throw std::runtime_error("could not listen on port " + std::to_string(port) + ".");
+        }
+
+        this->sockets.assign(this->n_ranks - 1, -1);
+        for (int joined = 1; joined < this->n_ranks; ++joined) {
+            int fd = accept(listener, nullptr, nullptr);
+            int32_t r = -1;
+            if (fd != -1)
+                receive_all(fd, &r, sizeof(r));
+            if (r < 1 || r >= this->n_ranks || this->sockets[r - 1] != -1) {
+                if (fd != -1)
+                    close(fd);
+                close(listener);
+                throw std::runtime_error("a cluster rank failed to join, or joined twice.");
+            }
+            set_no_delay(fd);
+            this->sockets[r - 1] = fd;
+        }
+        close(listener);
+    }
+
+    // Connect to rank 0 at host and port, retrying until it listens, and send it this rank
+    void connect_to_root(const std::string& host, int port) {
+        auto deadline = std::chrono::steady_clock::now() + CONNECT_TIMEOUT;
+        while (true) {
+            addrinfo* addresses = resolve(host, port, false);
+            int fd = -1;
+            for (addrinfo* a = addresses; a && fd == -1; a = a->ai_next) {
+                fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+                if (fd != -1 && connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+                    close(fd);
+                    fd = -1;
+                }
+            }
+            freeaddrinfo(addresses);
+            if (fd != -1) {
+                set_no_delay(fd);
+                this->sockets = {fd};
+                int32_t r = this->rank;
+                send_all(fd, &r, sizeof(r));
+                return;
+            }
+            if (std::chrono::steady_clock::now() > deadline)
+                throw std::runtime_error("could not connect to " + host + ":" +
+                                         std::to_string(port) + ".");
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+public:
+    // Join the cluster of n_ranks processes as rank. Rank 0 listens on port and every other rank
+    // connects to it at host, retrying while rank 0 isn't up yet; both block until every rank has
+    // joined. A cluster of one rank opens no connections.
+    Cluster(const std::string& host, int port, int rank, int n_ranks) :
+        rank(rank), n_ranks(n_ranks) {
+        if (n_ranks < 1 || rank < 0 || rank >= n_ranks)
+            throw std::runtime_error("rank " + std::to_string(rank) + " is not in a cluster of " +
+                                     std::to_string(n_ranks) + ".");
+        if (n_ranks == 1)
+            return;
+        if (rank == 0)
+            this->accept_ranks(port);
+        else
+            this->connect_to_root(host, port);
+    }
+
+    Cluster(const Cluster&) = delete;
+    Cluster& operator=(const Cluster&) = delete;
+
+    ~Cluster() {
+        for (int fd : this->sockets)
+            close(fd);
+    }
+
+    int get_rank() const { return this->rank; }
+
+    int get_n_ranks() const { return this->n_ranks; }
+
+    // Overwrite the n bytes at data on every rank with rank 0's
+    void broadcast(void* data, std::size_t n) {
+        if (this->rank == 0)
+            for (int fd : this->sockets)
+                send_all(fd, data, n);
+        else
+            receive_all(this->sockets[0], data, n);
+    }
+
+    // Replace data[i] for i < n, on every rank, with its sum over every rank, added up in rank
+    // order. Every rank must call it with the same n.
+    template <class T>
+    void all_reduce(T* data, std::size_t n) {
+        if (this->rank != 0) {
+            send_all(this->sockets[0], data, n * sizeof(T));
+            receive_all(this->sockets[0], data, n * sizeof(T));
+            return;
+        }
+        std::vector<T> buffer(this->sockets.empty() ? 0 : n);
+        for (int fd : this->sockets) {
+            receive_all(fd, buffer.data(), n * sizeof(T));
+            for (std::size_t i = 0; i < n; ++i)
+                data[i] += buffer[i];
+        }
+        for (int fd : this->sockets)
+            send_all(fd, data, n * sizeof(T));
+    }
+};
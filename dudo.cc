@@ -1,190 +1,264 @@
+#include "cluster.h"
+#include "dudo.h"
+#include "metrics.h"
+#include "strategy_file.h"
+
+#include <algorithm>
+#include <bit>
+#include <array>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
-#include <ratio>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
 #include <vector>
 #include <unordered_map>
-#include <random>
+#include <cstdint>
 using namespace std;
+using namespace dudo;
 
-const int D_TOTAL = 2;
-const int NUM_SIDES = 6;
-const int NUM_ACTIONS = 2 * NUM_SIDES + 1;
-const int DUDO = NUM_ACTIONS - 1;
-const vector<string> NUM_CLAIMS =
-    {"1", "1", "1", "1", "1", "1", "2", "2", "2", "2", "2", "2"};
-const vector<string> CLAIM_RANKS =
-    {"2", "3", "4", "5", "6", "1", "2", "3", "4", "5", "6", "1"};
+// How to run a solve, besides the solver's own options
+struct Run {
+    int T = 1000;
+    string checkpoint = "dudo.checkpoint";
+    int checkpoint_every = 0;
+    bool resume = false;
+    string stats;
+    shared_ptr<MetricsSink> metrics;
+    int metrics_every = 100, exploitability_every = 0;
+    string warm_start;
+    double warm_start_weight = 100;
+    // distributed training, if set
+    shared_ptr<Cluster> cluster;
+    int sync_every = 1;
+};
 
-// InfoSet:
-//
-// i1
-// x a*b a*b ...
-// ^     ^^^--------n = a, r = b claim
-// die I rolled
-//
-// i2
-// y a*b a*b ...
+// Start solver from the solution of another configuration at path
+template <class Solver>
+void warm_start(Solver& solver, const string& path, double weight) {
+    StrategyImage image(path);
+    const StrategyHeader& header = image.get_header();
+    InfoSetTable source(Rules::parse(header.get_game()));
+    if ((int) header.n_actions != source.get_rules().get_n_actions() ||
+        (long) header.n_info_sets != source.get_n_info_sets())
+        throw runtime_error(path + " does not match the tables of " + header.get_game());
+    solver.warm_start(image, get_warm_start_map(solver.get_table(), source), weight);
+    cout << "Warm started from " << header.get_game() << '\n';
+}
 
-class Node {
-private:
-    int n_actions;
-    string info_set;
-    vector<double> regret_sum, strategy, strategy_sum;
-public:
-    Node(string info_set) : info_set(info_set) {
-        this->n_actions = (info_set.length() >= 4) ? NUM_ACTIONS : NUM_ACTIONS - 1;
-        // zero out all arrays
-        this->regret_sum.resize(n_actions);
-        this->strategy.resize(n_actions);
-        for (int a = 0; a < n_actions; ++a) this->strategy[a] = 1.0 / n_actions;
-        this->strategy_sum.resize(n_actions);
+// Train solver until run.T iterations are done, warm starting, checkpointing, resuming and
+// reporting progress as asked, and print the results. In a cluster, only rank 0 reads and writes
+// checkpoints and prints; the other ranks start from its sums.
+template <class Solver>
+void solve(Solver& solver, const Run& run) {
+    bool root = !run.cluster || run.cluster->get_rank() == 0;
+    bool resumed = false;
+    if (root && run.resume) {
+        try {
+            StrategyImage image = solver.load(run.checkpoint);
+            solver.resume(image);
+            resumed = true;
+            cout << "Resumed from iteration " << solver.get_iteration() << '\n';
+        } catch (const runtime_error& e) {
+            cout << "No checkpoint to resume (" << e.what() << "), starting from scratch" << '\n';
+        }
     }
+    // a resumed solve already carries its warm start
+    if (root && !resumed && !run.warm_start.empty())
+        warm_start(solver, run.warm_start, run.warm_start_weight);
+    if (run.cluster)
+        solver.set_cluster(run.cluster, run.sync_every);
+    if (root && run.checkpoint_every > 0)
+        solver.set_checkpoint(run.checkpoint, run.checkpoint_every);
+    if (!run.stats.empty())
+        solver.set_stats_file(run.stats);
+    if (run.metrics)
+        solver.set_metrics(run.metrics, run.metrics_every, run.exploitability_every);
 
-    bool is_terminal() {
-        return this->info_set.back() == 'D';
-    }
-
-    int get_utility(vector<int>& dice) {
-        if (!this->is_terminal())
-            throw runtime_error("called get_utility on non-terminal node.");
-
-        int h = this->info_set.length();
-        int n = this->info_set[h - 4];
-        int r = this->info_set[h - 2];
-        int rank_count = (dice[0] == r || dice[0] == 1) + (dice[1] == r || dice[1] == 1);
-        int diff = rank_count - n;
-
-        // values are all wrt to challenged player
-        if (diff > 0)
-            // the claim was smaller
-            return diff;
-        else if (diff < 0)
-            // the claim was bigger
-            return -diff;
-        else
-            // the claim was right
-            return 1;
+    if (solver.get_iteration() < run.T) {
+        double util = solver.train(run.T - solver.get_iteration());
+        // the reports may be going to stdout too
+        if (run.metrics)
+            run.metrics->flush();
+        if (root)
+            cout << "Expected game value: " << util << '\n';
     }
+    if (!root)
+        return;
+    if (run.checkpoint_every > 0)
+        solver.save(run.checkpoint);
+    cout << "Exploitability: " << solver.compute_exploitability() << '\n';
+}
 
-    int get_n_actions() { return this->n_actions; }
+// usage: dudo [--threads N] [--sampling none|chance|external|outcome] [--iterations T]
+//             [--policy cfr|cfr+|linear|dcfr] [--seed S] [--public-tree]
+//             [--checkpoint PATH] [--checkpoint-every N] [--resume] [--stats PATH]
+//             [--precision double|float] [--prune THRESHOLD] [--prune-interval N]
+//             [--metrics PATH] [--metrics-format text|csv|json] [--metrics-every N]
+//             [--exploitability-every N] [--warm-start PATH] [--warm-start-weight W]
+//             [--cluster HOST:PORT --ranks N --rank R] [--sync-every K]
+//
+// With --resume, training continues from the checkpoint at PATH until T iterations are done.
+// --stats writes the solver's instrumentation to PATH as JSON, when built with -DCFR_STATS.
+// --precision float stores the regret and strategy sums in half the memory.
+// --prune skips actions whose regret is below THRESHOLD (a negative number), walking the whole
+// tree again every N passes.
+// --metrics reports progress every N iterations to PATH, or to stdout if PATH is -, from a
+// background thread. The reports include the exploitability every --exploitability-every
+// iterations, which is computed on the training thread.
+// --warm-start starts from the checkpoint at PATH of this configuration, or of its abstraction
+// with a coarser recall (see -DDUDO_RECALL in dudo.h). Its strategy is played for W passes over
+// every deal before training, so the larger W, the longer training keeps to it.
+// --cluster trains as rank R of N processes, on this machine or others, that split the deals
+// between them. Rank 0 listens on PORT and the others connect to it at HOST, and every K
+// iterations the ranks merge their regret and strategy updates.
+int main(int argc, char** argv) {
+    SolverOptions options;
+    Run run;
+    bool single = false;
+    string cluster_address;
+    int rank = 0, n_ranks = 1;
+    string metrics_path;
+    MetricsFormat metrics_format = MetricsFormat::TEXT;
 
-    // Update strategy using regret matching, using p as the probability
-    // of being in this state
-    vector<double> get_strategy(double p) {
-        double norm = 0;
-        for (int a = 0; a < this->n_actions; a++) {
-            this->strategy[a] = max(this->regret_sum[a], 0.0);
-            norm += this->strategy[a];
+    // the numbers are parsed as they are read, and throw if they aren't numbers
+    string arg, value;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            arg = argv[i];
+            if (arg == "--resume") {
+                run.resume = true;
+                continue;
+            }
+            if (arg == "--public-tree") {
+                options.public_tree = true;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                cerr << "missing value for " << arg << '\n';
+                return 1;
+            }
+            value = argv[++i];
+            if (arg == "--threads") {
+                options.n_threads = stoi(value);
+            } else if (arg == "--iterations") {
+                run.T = stoi(value);
+            } else if (arg == "--seed") {
+                options.seed = stoull(value);
+            } else if (arg == "--checkpoint") {
+                run.checkpoint = value;
+            } else if (arg == "--checkpoint-every") {
+                run.checkpoint_every = stoi(value);
+            } else if (arg == "--stats") {
+                run.stats = value;
+            } else if (arg == "--metrics") {
+                metrics_path = value;
+            } else if (arg == "--metrics-format") {
+                if (value == "csv")
+                    metrics_format = MetricsFormat::CSV;
+                else if (value == "json")
+                    metrics_format = MetricsFormat::JSON;
+                else if (value != "text") {
+                    cerr << "unknown metrics format " << value << '\n';
+                    return 1;
+                }
+            } else if (arg == "--metrics-every") {
+                run.metrics_every = stoi(value);
+            } else if (arg == "--exploitability-every") {
+                run.exploitability_every = stoi(value);
+            } else if (arg == "--warm-start") {
+                run.warm_start = value;
+            } else if (arg == "--warm-start-weight") {
+                run.warm_start_weight = stod(value);
+            } else if (arg == "--cluster") {
+                cluster_address = value;
+            } else if (arg == "--ranks") {
+                n_ranks = stoi(value);
+            } else if (arg == "--rank") {
+                rank = stoi(value);
+            } else if (arg == "--sync-every") {
+                run.sync_every = stoi(value);
+            } else if (arg == "--prune") {
+                options.prune_threshold = stod(value);
+                if (!(options.prune_threshold < 0)) {
+                    cerr << "prune threshold must be negative, not " << value << '\n';
+                    return 1;
+                }
+            } else if (arg == "--prune-interval") {
+                options.prune_interval = stoi(value);
+            } else if (arg == "--precision") {
+                if (value != "double" && value != "float") {
+                    cerr << "unknown precision " << value << '\n';
+                    return 1;
+                }
+                single = (value == "float");
+            } else if (arg == "--sampling") {
+                if (value == "chance")
+                    options.sampling = Sampling::CHANCE;
+                else if (value == "external")
+                    options.sampling = Sampling::EXTERNAL;
+                else if (value == "outcome")
+                    options.sampling = Sampling::OUTCOME;
+                else if (value != "none") {
+                    cerr << "unknown sampling " << value << '\n';
+                    return 1;
+                }
+            } else if (arg == "--policy") {
+                if (value == "cfr+")
+                    options.policy = RegretPolicy::CFR_PLUS;
+                else if (value == "linear")
+                    options.policy = RegretPolicy::LINEAR;
+                else if (value == "dcfr")
+                    options.policy = RegretPolicy::DCFR;
+                else if (value != "cfr") {
+                    cerr << "unknown policy " << value << '\n';
+                    return 1;
+                }
+            } else {
+                cerr << "unknown option " << arg << '\n';
+                return 1;
+            }
         }
-        for (int a = 0; a < this->n_actions; a++) {
-            if (norm > 0)
-                this->strategy[a] /= norm;
-            else
-                this->strategy[a] = 1.0 / this->n_actions;
-            this->strategy_sum[a] += p * this->strategy[a];
-        }
-        return this->strategy;
+    } catch (const logic_error&) {
+        cerr << "bad value for " << arg << ": " << value << '\n';
+        return 1;
     }
 
-    // Update regret value
-    void update_regret(int a, double v) {
-        this->regret_sum[a] += v;
-    }
-
-    // Return computed strategy at this node
-    vector<double> get_average_strategy() {
-        vector<double> average_strategy(NUM_ACTIONS);
-        double norm = 0;
-        for (int a = 0; a < this->n_actions; ++a)
-            norm += this->strategy_sum[a];
-        for (int a = 0; a < this->n_actions; ++a) {
-            if (norm > 0)
-            average_strategy[a] = this->strategy_sum[a] / norm;
-            else
-            average_strategy[a] = 1.0 / this->n_actions;
+    size_t colon = cluster_address.rfind(':');
+    int port = 0;
+    if (!cluster_address.empty()) {
+        try {
+            if (colon == string::npos)
+                throw invalid_argument("no port");
+            port = stoi(cluster_address.substr(colon + 1));
+        } catch (const logic_error&) {
+            cerr << "--cluster takes HOST:PORT" << '\n';
+            return 1;
         }
-        return average_strategy;
     }
-};
-
-class Solver {
-private:
-    unordered_map<string, Node*> tree;
 
-    // Return node if it exists, otherwise make it and return it
-    Node* get_node(string info_set) {
-        if (this->tree.count(info_set))
-            return this->tree[info_set];
+    // bad options, files and cluster ranks surface as runtime errors
+    try {
+        if (!cluster_address.empty())
+            run.cluster = make_shared<Cluster>(cluster_address.substr(0, colon), port, rank,
+                                               n_ranks);
+        if (metrics_path == "-")
+            run.metrics = make_shared<MetricsSink>(cout, metrics_format);
+        else if (!metrics_path.empty())
+            run.metrics = make_shared<MetricsSink>(metrics_path, metrics_format);
 
-        this->tree[info_set] = new Node(info_set);
-        return this->tree[info_set];
-    }
-
-    // Use counterfactual regret minimization to compute utility of node
-    double cfr(vector<int>& dice, string h, double p1, double p2) {
-        int player_idx = h.length() % 2;
-        string info_set = to_string(dice[player_idx]) + h;
-        Node* node = this->get_node(info_set);
-
-        // base case: return payoff for terminal state
-        if (node->is_terminal())
-            return node->get_utility(dice);
-
-        // compute reach probability
-        double reach_p = (player_idx == 0) ? p2 : p1;
-        // update current player's strategy
-        vector<double> strategy = node->get_strategy(reach_p);
-
-        int n_actions = node->get_n_actions();
-        vector<double> util(n_actions);
-        // utility of this node (the eventual return value of the cfr)
-        double node_util = 0;
-
-        // traverse over possible actions
-        for (int a = 0; a < n_actions; ++a) {
-            string action = (a == DUDO) ? "D" : NUM_CLAIMS[a] + CLAIM_RANKS[a];
-            // player_idx = 0 corresponds to player 1's action
-            if (player_idx == 0)
-                util[a] = -cfr(dice, h + action, p1 * strategy[a], p2);
-            else
-                util[a] = -cfr(dice, h + action, p1, p2 * strategy[a]);
-
-            // update total node utility
-            node_util += strategy[a] * util[a];
-        }
-
-        // update regret for each action
-        for (int a = 0; a < n_actions; ++a) {
-            double regret = util[a] - node_util;
-            node->update_regret(a, reach_p * regret);
+        if (single) {
+            FloatSolver solver(options);
+            solve(solver, run);
+        } else {
+            Solver solver(options);
+            solve(solver, run);
         }
-
-        return node_util;
+    } catch (const runtime_error& e) {
+        cerr << e.what() << '\n';
+        return 1;
     }
-public:
-    void train(int T) {
-        vector<int> dice;
-        for (int d = 1; d <= 6; ++d) {
-            dice.push_back(d);
-            dice.push_back(d);
-        }
-        // random shuffle
-        random_device rd = random_device();
-        default_random_engine rng = default_random_engine(rd());
-        ranges::shuffle(dice, rng);
-
-        clock_t start_time = clock();
-        double util = 0;
-        for (int i = 0; i < T; ++i) {
-            util += cfr(dice, "", 1, 1);
-            next_permutation(dice.begin(), dice.end());
-        }
-
-        cout << "Expected game value: " << util / T << '\n';
-    }
-};
-
-
-int main() {
-    Solver solver;
-    solver.train(1000);
 }
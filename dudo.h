@@ -0,0 +1,371 @@
+#pragma once
+
+#include "cfr.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Dudo: the claim tree, the dice and their plug-in for the CFR engine in cfr.h
+
+namespace dudo {
+
+// dice per player, and sides per die. The claim tree has about 2^(2 * NUM_DICE * NUM_SIDES)
+// histories, so only small configurations can be solved exactly. Build with -DDUDO_DICE=n or
+// -DDUDO_SIDES=n to solve another configuration.
+#ifndef DUDO_DICE
+#define DUDO_DICE 1
+#endif
+#ifndef DUDO_SIDES
+#define DUDO_SIDES 6
+#endif
+const int NUM_DICE = DUDO_DICE;
+const int NUM_SIDES = DUDO_SIDES;
+const int D_TOTAL = 2 * NUM_DICE;
+// claims of count n and rank r are ordered by n, then by r = 2, ..., NUM_SIDES, 1
+const int DUDO = D_TOTAL * NUM_SIDES;
+const int NUM_ACTIONS = DUDO + 1;
+// number of most recent claims a player remembers. DUDO is perfect recall; the usual abstraction
+// for larger games is 3, which bounds the info sets per roll by 2 * (C(DUDO, 0) + ... +
+// C(DUDO, 3)) however large the claim tree is, and the stored histories by twice that. Walks
+// still take every path through them, so it bounds memory but not the time of an iteration.
+// Build with -DDUDO_RECALL=n to solve with that abstraction, e.g. to warm start perfect recall
+// from.
+#ifdef DUDO_RECALL
+const int RECALL = DUDO_RECALL;
+#else
+const int RECALL = DUDO;
+#endif
+static_assert(RECALL >= 1, "players must remember the claim they may challenge");
+static_assert(DUDO <= 32, "the claims made must fit in a 32-bit mask");
+
+constexpr int binomial(int n, int k) {
+    int res = 1;
+    for (int i = 1; i <= k; ++i)
+        res = res * (n - k + i) / i;
+    return res;
+}
+
+// A player's roll, as the number of their dice showing each face (index 1 to NUM_SIDES). Order
+// doesn't matter, so a player holds one of NUM_ROLLS private states.
+typedef std::array<int, NUM_SIDES + 1> Roll;
+const int NUM_ROLLS = binomial(NUM_SIDES + NUM_DICE - 1, NUM_DICE);
+
+// Append every roll of n more dice of n_sides sides, none lower than face, to rolls
+inline void add_rolls(Roll roll, int n, int face, int n_sides, std::vector<Roll>& rolls) {
+    if (n == 0) {
+        rolls.push_back(roll);
+        return;
+    }
+    for (int f = face; f <= n_sides; ++f) {
+        ++roll[f];
+        add_rolls(roll, n - 1, f, n_sides, rolls);
+        --roll[f];
+    }
+}
+
+inline std::vector<Roll> get_rolls(int n_dice = NUM_DICE, int n_sides = NUM_SIDES) {
+    std::vector<Roll> rolls;
+    add_rolls(Roll{}, n_dice, 1, n_sides, rolls);
+    return rolls;
+}
+
+// ROLLS[x - 1] = roll of private state x. With one die each, x is just the face.
+const std::vector<Roll> ROLLS = get_rolls();
+
+// Returns the number of ordered dice outcomes that give roll
+inline double get_roll_weight(const Roll& roll) {
+    double weight = 1;
+    for (int i = 1; i <= NUM_DICE; ++i)
+        weight *= i;
+    for (int f = 1; f <= NUM_SIDES; ++f)
+        for (int i = 1; i <= roll[f]; ++i)
+            weight /= i;
+    return weight;
+}
+
+// A Dudo configuration. Training always uses the compiled-in one, which the defaults describe;
+// others describe the strategy files of other builds, such as the coarser recalls that a solve
+// can be warm started from.
+struct Rules {
+    int n_dice = NUM_DICE, n_sides = NUM_SIDES, recall = RECALL;
+
+    // the dudo action, after every claim
+    int get_dudo() const { return 2 * this->n_dice * this->n_sides; }
+
+    int get_n_actions() const { return this->get_dudo() + 1; }
+
+    // Returns the number of dice claimed by claim c
+    int get_claim_count(int c) const { return c / this->n_sides + 1; }
+
+    // Returns the rank claimed by claim c, where 1 is the highest rank and is wild
+    int get_claim_rank(int c) const { return (c + 1) % this->n_sides + 1; }
+
+    // Returns the claim of count dice of rank
+    int get_claim(int count, int rank) const {
+        return (count - 1) * this->n_sides + (rank + this->n_sides - 2) % this->n_sides;
+    }
+
+    // Returns claims with all but the recall most recent claims cleared
+    uint32_t get_recalled_claims(uint32_t claims) const {
+        while (std::popcount(claims) > this->recall)
+            claims &= claims - 1;
+        return claims;
+    }
+
+    // Returns the tag of this configuration's strategy files, e.g. dudo-2x6, or dudo-2x6-r3 with
+    // imperfect recall
+    std::string get_name() const {
+        return "dudo-" + std::to_string(2 * this->n_dice) + "x" + std::to_string(this->n_sides) +
+               ((this->recall < this->get_dudo()) ? "-r" + std::to_string(this->recall) : "");
+    }
+
+    // Returns whether these rules describe a game: a die each, two sides, a remembered claim,
+    // and no more claims than fit a 32-bit mask
+    bool is_valid() const {
+        return this->n_dice >= 1 && this->n_sides >= 2 && this->recall >= 1 &&
+               2L * this->n_dice * this->n_sides <= 32;
+    }
+
+    // Returns the configuration tagged name, which may come from an untrusted file
+    static Rules parse(const std::string& name) {
+        Rules rules;
+        int total = 0;
+        int n = std::sscanf(name.c_str(), "dudo-%dx%d-r%d", &total, &rules.n_sides,
+                            &rules.recall);
+        rules.n_dice = total / 2;
+        // perfect recall, once the claims are known to fit
+        if (n == 2)
+            rules.recall = 1;
+        if (n < 2 || !rules.is_valid())
+            throw std::runtime_error(name + " is not a dudo configuration.");
+        if (n == 2)
+            rules.recall = rules.get_dudo();
+        if (rules.get_name() != name)
+            throw std::runtime_error(name + " is not a dudo configuration.");
+        return rules;
+    }
+};
+
+// tag identifying strategy files of this configuration
+const std::string GAME = Rules().get_name();
+
+// InfoSet:
+//
+// (x, h)
+//  ^  ^--------history of claims, each strictly greater than the last, optionally ending in dudo
+//  roll I hold
+//
+// Claims strictly increase, so a history is determined by the set of claims made, a bitmask
+// with bit c set if claim c was made. The information set key is that mask reduced to its
+// RECALL highest (most recent) bits, plus the player to move.
+//
+// Every history is given a dense integer id when the claim tree is built, and every distinct key
+// a dense decision id, so traversal never builds or hashes a string. Histories that differ only
+// in forgotten claims have the same legal actions, payoffs and keys below them, so they share an
+// id: the table stores the graph of recalled claims, and walks through it see the whole tree.
+
+// Enumerates the claim tree of a configuration once, indexing histories and information sets
+// densely. Solvers run on the compiled-in configuration; a table of another one, no larger, reads
+// its strategy files.
+class InfoSetTable {
+private:
+    Rules rules;
+    int dudo, n_rolls;
+    std::vector<Roll> rolls;
+    // child[h * NUM_ACTIONS + a] = id of history h followed by action a (-1 if a is illegal).
+    // Rows are as wide as the compiled-in configuration's, whatever the rules.
+    std::vector<int> child;
+    // decision[h] = dense index of the information set key of non-terminal history h (-1 if h
+    // ends with dudo)
+    std::vector<int> decision;
+    std::unordered_map<uint64_t, int> key_decision;
+    // last_claim[h] = most recent claim in history h (-1 at the root), claims[h] the set of the
+    // claims made that are remembered, and player[h] the player to move
+    std::vector<int> last_claim;
+    std::vector<uint32_t> claims;
+    std::vector<int> player;
+    // utility[(claim * NUM_ROLLS + x0 - 1) * NUM_ROLLS + x1 - 1] = payoff wrt the challenged
+    // player of calling dudo on claim when the players hold rolls x0 and x1
+    std::vector<int> utility;
+    int n_decisions = 0;
+
+    // Returns payoff wrt the challenged player of calling dudo on claim
+    int get_payoff(int claim, const Roll& roll0, const Roll& roll1) const {
+        int n = this->rules.get_claim_count(claim);
+        int r = this->rules.get_claim_rank(claim);
+        // ones are wild
+        int rank_count = roll0[r] + roll1[r] + ((r != 1) ? roll0[1] + roll1[1] : 0);
+        int diff = rank_count - n;
+
+        // values are all wrt to challenged player
+        if (diff != 0)
+            // positive if the claim was smaller, negative if it was bigger
+            return diff;
+        else
+            // the claim was right
+            return 1;
+    }
+
+    // Returns the decision id of the info set key (claims, player), adding it if it is new
+    int get_decision(uint32_t claims, int player) {
+        uint64_t key = (uint64_t) this->rules.get_recalled_claims(claims) << 1 | player;
+        auto [it, added] = this->key_decision.try_emplace(key, this->n_decisions);
+        if (added)
+            ++this->n_decisions;
+        return it->second;
+    }
+
+    // Returns the id of the history of claims, the last of them claim, with player to move,
+    // adding it and everything below it unless a history remembering the same claims has been.
+    // histories maps every key to its id.
+    int build(int claim, uint32_t claims, int player, bool terminal,
+              std::unordered_map<uint64_t, int>& histories) {
+        claims = this->rules.get_recalled_claims(claims);
+        uint64_t key = (uint64_t) claims << 2 | terminal << 1 | player;
+        auto [it, added] = histories.try_emplace(key, this->decision.size());
+        if (!added)
+            return it->second;
+        int id = it->second;
+        this->child.resize(this->child.size() + NUM_ACTIONS, -1);
+        this->decision.push_back(terminal ? -1 : this->get_decision(claims, player));
+        this->last_claim.push_back(claim);
+        this->claims.push_back(claims);
+        this->player.push_back(player);
+
+        if (!terminal) {
+            // claims must strictly increase, and dudo needs a claim to challenge
+            for (int a = claim + 1; a < this->dudo; ++a) {
+                int c = this->build(a, claims | 1u << a, 1 - player, false, histories);
+                this->child[id * NUM_ACTIONS + a] = c;
+            }
+            if (claim != -1) {
+                int c = this->build(claim, claims, 1 - player, true, histories);
+                this->child[id * NUM_ACTIONS + this->dudo] = c;
+            }
+        }
+        return id;
+    }
+public:
+    static const int ROOT = 0;
+
+    // The rules are checked before anything is built from them, as they may come from a file
+    explicit InfoSetTable(Rules rules = {}) : rules(rules) {
+        if (!rules.is_valid())
+            throw std::runtime_error(rules.get_name() + " is not a valid dudo configuration.");
+        if (rules.n_sides > NUM_SIDES || rules.get_n_actions() > NUM_ACTIONS)
+            throw std::runtime_error(rules.get_name() + " is larger than " + GAME + ".");
+        this->dudo = rules.get_dudo();
+        this->rolls = dudo::get_rolls(rules.n_dice, rules.n_sides);
+        this->n_rolls = this->rolls.size();
+        std::unordered_map<uint64_t, int> histories;
+        this->build(-1, 0, 0, false, histories);
+        for (int claim = 0; claim < this->dudo; ++claim)
+            for (const Roll& roll0 : this->rolls)
+                for (const Roll& roll1 : this->rolls)
+                    this->utility.push_back(this->get_payoff(claim, roll0, roll1));
+    }
+
+    int get_child(int h, int a) const { return this->child[h * NUM_ACTIONS + a]; }
+
+    bool is_terminal(int h) const { return this->decision[h] == -1; }
+
+    // Returns index of the player to move after history h
+    int get_player(int h) const { return this->player[h]; }
+
+    // Legal actions after history h are [get_first_action(h), get_last_action(h))
+    int get_first_action(int h) const { return this->last_claim[h] + 1; }
+
+    int get_last_action(int h) const {
+        return (this->last_claim[h] == -1) ? this->dudo : this->dudo + 1;
+    }
+
+    // Returns id of the information set where the player to move holds roll x
+    int get_info_set(int x, int h) const { return this->decision[h] * this->n_rolls + x - 1; }
+
+    int get_n_histories() const { return this->decision.size(); }
+
+    int get_n_info_sets() const { return this->n_decisions * this->n_rolls; }
+
+    const Rules& get_rules() const { return this->rules; }
+
+    // ROLLS of these rules: roll x is get_rolls()[x - 1]
+    const std::vector<Roll>& get_rolls() const { return this->rolls; }
+
+    // Returns the set of claims made in history h that the players remember, bit c for claim c
+    uint32_t get_claims(int h) const { return this->claims[h]; }
+
+    // Returns id of the information set of player holding roll x after claims, or -1 if no
+    // history has that key
+    int find_info_set(int x, uint32_t claims, int player) const {
+        uint64_t key = (uint64_t) this->rules.get_recalled_claims(claims) << 1 | player;
+        auto it = this->key_decision.find(key);
+        return (it == this->key_decision.end()) ? -1 : it->second * this->n_rolls + x - 1;
+    }
+
+    // Returns payoff for terminal history h, wrt the challenged player (the player to move)
+    int get_utility(int h, const std::vector<int>& deal) const {
+        if (!this->is_terminal(h))
+            throw std::runtime_error("called get_utility on non-terminal history.");
+
+        int claim = this->last_claim[h];
+        return this->utility[(claim * this->n_rolls + deal[0] - 1) * this->n_rolls + deal[1] - 1];
+    }
+};
+
+// Returns the abstraction that warm starts table from source, the table of the same game with no
+// finer a recall: a CfrSolver::WarmStartMap from every entry of table to its entry of source,
+// with the claims keyed with the source's recall. Information sets whose claims aren't a source
+// key get no source strategy. The map refers to both tables.
+//
+// Sources with fewer sides, their lowest ranks folded together, were tried too, and trained more
+// slowly than a cold start at every weight, so only the recall may differ.
+inline std::function<long(int, int, int)> get_warm_start_map(const InfoSetTable& table,
+                                                             const InfoSetTable& source) {
+    const Rules &from = table.get_rules(), &to = source.get_rules();
+    if (from.n_dice != to.n_dice || from.n_sides != to.n_sides || to.recall > from.recall)
+        throw std::runtime_error("can't warm start " + from.get_name() + " from " +
+                                 to.get_name() + ": it needs the same dice and sides, and no " +
+                                 "finer a recall.");
+
+    // the remembered claims include the last, so the same actions are legal in the source
+    return [&table, &source](int x, int h, int a) -> long {
+        int i = source.find_info_set(x, table.get_claims(h), table.get_player(h));
+        return (i == -1) ? -1 : (long) i * source.get_rules().get_n_actions() + a;
+    };
+}
+
+// Plugs Dudo into the CFR engine in cfr.h
+struct DudoTraits {
+    using Table = InfoSetTable;
+    static constexpr int NUM_ACTIONS = dudo::NUM_ACTIONS;
+    static constexpr int NUM_PRIVATE = NUM_ROLLS;
+    static inline const std::string NAME = GAME;
+
+    // every pair of rolls
+    static std::vector<Deal> get_deals() {
+        std::vector<Deal> deals;
+        for (int x0 = 1; x0 <= NUM_ROLLS; ++x0)
+            for (int x1 = 1; x1 <= NUM_ROLLS; ++x1)
+                deals.push_back({x0, x1});
+        return deals;
+    }
+
+    // rolls are independent, and each as likely as the dice outcomes that give it
+    static double get_weight(const Deal& deal) {
+        return get_roll_weight(ROLLS[deal[0] - 1]) * get_roll_weight(ROLLS[deal[1] - 1]);
+    }
+};
+
+typedef CfrSolver<DudoTraits> Solver;
+// stores the regret and strategy sums as float
+typedef CfrSolver<DudoTraits, float> FloatSolver;
+
+}  // namespace dudo
@@ -0,0 +1,240 @@
+#pragma once
+
+#include "cfr.h"
+#include "policy.h"
+#include "rng.h"
+#include "strategy_file.h"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// Kuhn Poker: the betting tree and its plug-in for the CFR engine in cfr.h
+
+namespace kuhn {
+
+// In Kuhn Poker, both players ante 1 chip. Then each player is dealt a card out of the deck
+// {1, 2, 3}. Play alternates starting with player 1. A player can check or bet 1 chip. When a
+// player passes after a bet, the opponent takes all chips in the pot. When there are two
+// successive passes or two successive bets, both players reveal their cards, and the player with
+// the higher card takes all chips in the pot.
+
+// Table of all possible game sequences:
+
+// ----------------------------------------------------------
+// |  P1   |  P2   |  P1   |           Result               |
+// ----------------------------------------------------------
+// | check | check |       | +1 to player with higher card  |
+// | check |  bet  | check | +1 to P2                       |
+// | check |  bet  |  bet  | +2 to player with higher card  |
+// |  bet  | check |       | +1 to P1                       |
+// |  bet  |  bet  |       | +2 to player with higher card  |
+// ----------------------------------------------------------
+
+// DEFINITIONS
+// History           - Sequence of actions starting from the root of the game that result in a
+//                     game state.
+// Reach Probability - The probability of reaching a particular game state.
+// Information set   - Containins an active player, and all the information available to that player
+//                     at that decision in the game. Could consist of multiple possible game states,
+//                     if the player is missing information.
+
+// There are 12 possible information sets:
+// * PX = player to move, CX = card of PX, H = history of betting
+// 1)  P1, H = {}    , C1 = 1
+// 2)  P1, H = {}    , C1 = 2
+// 3)  P1, H = {}    , C1 = 3
+// 4)  P1, H = {c, b}, C1 = 1
+// 5)  P1, H = {c, b}, C1 = 2
+// 6)  P1, H = {c, b}, C1 = 3
+// 7)  P2, H = {c}   , C2 = 1
+// 8)  P2, H = {c}   , C2 = 2
+// 9)  P2, H = {c}   , C2 = 3
+// 10) P2, H = {b}   , C2 = 1
+// 11) P2, H = {b}   , C2 = 2
+// 12) P2, H = {b}   , C2 = 3
+
+constexpr std::string_view ACTIONS = "cb";
+constexpr int NUM_ACTIONS = ACTIONS.length();
+const std::unordered_set<std::string> TERMINAL_HISTORIES = {"cc", "bb", "bc", "cbc", "cbb"};
+
+const int NUM_CARDS = 3;
+// tag identifying kuhn strategy files
+const std::string GAME = "kuhn";
+
+// Enumerates the betting tree once and gives every history and every information set a dense
+// integer id, so CFR traversal walks child ids instead of building and hashing strings.
+class InfoSetTable {
+private:
+    // child[h * NUM_ACTIONS + a] = id of history h followed by action a (-1 if h is terminal)
+    std::vector<int> child;
+    // decision[h] = dense index of non-terminal history h (-1 if h is terminal)
+    std::vector<int> decision;
+    std::vector<std::string> history;
+    // player[h] = index of the player to move after history h
+    std::vector<int> player;
+    // utility[2 * h + w] = payoff of terminal history h wrt the player to move, where w says
+    // whether that player holds the higher card (0 for non-terminal histories)
+    std::vector<double> utility;
+    int n_decisions = 0;
+
+    // Returns payoff wrt the player to move after terminal history h, if they hold the higher
+    // card when higher is set
+    static double get_payoff(const std::string& h, bool higher) {
+        // we bet and they folded
+        if (h.ends_with("bc"))
+            return 1;
+
+        // action went check check
+        if (h == "cc")
+            return higher ? 1 : -1;
+
+        // action went bet call
+        return higher ? 2 : -2;
+    }
+
+    int build(std::string h) {
+        int id = this->history.size();
+        bool terminal = TERMINAL_HISTORIES.count(h);
+        this->history.push_back(h);
+        this->player.push_back(h.length() % 2);
+        this->child.resize(this->child.size() + NUM_ACTIONS, -1);
+        this->decision.push_back(terminal ? -1 : this->n_decisions++);
+        this->utility.push_back(terminal ? get_payoff(h, false) : 0);
+        this->utility.push_back(terminal ? get_payoff(h, true) : 0);
+
+        if (!terminal)
+            for (int a = 0; a < NUM_ACTIONS; ++a) {
+                int c = this->build(h + ACTIONS[a]);
+                this->child[id * NUM_ACTIONS + a] = c;
+            }
+        return id;
+    }
+public:
+    static const int ROOT = 0;
+
+    InfoSetTable() { this->build(""); }
+
+    int get_child(int h, int a) const { return this->child[h * NUM_ACTIONS + a]; }
+
+    // Both actions are legal after every non-terminal history
+    int get_first_action(int) const { return 0; }
+
+    int get_last_action(int) const { return NUM_ACTIONS; }
+
+    // Returns whether the game is over after history h
+    bool is_terminal(int h) const { return this->decision[h] == -1; }
+
+    // Returns index of the player to move after history h
+    int get_player(int h) const { return this->player[h]; }
+
+    const std::string& get_history(int h) const { return this->history[h]; }
+
+    // Returns id of the information set where the player to move holds card
+    int get_info_set(int card, int h) const { return this->decision[h] * NUM_CARDS + card - 1; }
+
+    int get_n_histories() const { return this->history.size(); }
+
+    int get_n_info_sets() const { return this->n_decisions * NUM_CARDS; }
+
+    // Returns payoff for terminal history h, wrt the player to move
+    double get_utility(int h, const std::vector<int>& cards) const {
+        if (!this->is_terminal(h))
+            throw std::runtime_error("called get_utility on non-terminal history.");
+
+        int p = this->player[h];
+        return this->utility[2 * h + (cards[p] > cards[1 - p])];
+    }
+};
+
+// Plugs Kuhn Poker into the CFR engine in cfr.h
+struct KuhnTraits {
+    using Table = InfoSetTable;
+    static constexpr int NUM_ACTIONS = kuhn::NUM_ACTIONS;
+    static constexpr int NUM_PRIVATE = NUM_CARDS;
+    static inline const std::string NAME = GAME;
+
+    // every permutation of the deck; player p holds deal[p] and the last card is unused
+    static std::vector<Deal> get_deals() {
+        std::vector<Deal> deals;
+        std::vector<int> cards = {1, 2, 3};
+        do deals.push_back(cards);
+        while (std::next_permutation(cards.begin(), cards.end()));
+        return deals;
+    }
+
+    // all deals are equally likely
+    static double get_weight(const Deal&) { return 1; }
+};
+
+typedef CfrSolver<KuhnTraits> Solver;
+// stores the regret and strategy sums as float
+typedef CfrSolver<KuhnTraits, float> FloatSolver;
+
+// One table the bot is seated at: the card it holds and the id of the betting so far
+struct Query {
+    int card;
+    int history;
+};
+
+// Plays from a frozen policy, for any number of tables at once. Nothing is written after
+// construction, so threads can share one Bot, each passing its own rng. Copies share the
+// policy rather than copying it.
+class Bot {
+private:
+    InfoSetTable table;
+    // a snapshot on the heap, full precision or quantized, or a strategy file served in place.
+    // It is null only if the bot was default constructed, to be assigned later.
+    std::variant<std::shared_ptr<const Policy>, std::shared_ptr<const Policy16>,
+                 std::shared_ptr<const Policy8>, std::shared_ptr<const ImagePolicy>> policy;
+
+    // Returns f(policy) for the policy the bot plays from
+    template <class F>
+    auto visit(F f) const {
+        return std::visit([&](const auto& policy) {
+            if (!policy)
+                throw std::runtime_error("bot has no policy");
+            return f(*policy);
+        }, this->policy);
+    }
+public:
+    // A bot with no policy yet, which can't act until another is assigned to it
+    Bot() = default;
+
+    // Play from a strategy file, reading its mapped pages rather than a copy of them
+    explicit Bot(StrategyImage strategy) :
+        policy(std::make_shared<const ImagePolicy>(std::move(strategy))) {}
+
+    // Play from a snapshot, such as one taken from a PolicySlot, or a quantized copy of one
+    template <class Entry>
+    explicit Bot(std::shared_ptr<const BasicPolicy<Entry>> policy) : policy(policy) {
+        if (!policy)
+            throw std::runtime_error("bot has no policy");
+    }
+
+    // Returns the action to play holding card after history h
+    int act(int card, int h, Rng& rng) const {
+        int i = this->table.get_info_set(card, h);
+        return this->visit([&](const auto& policy) { return policy.sample(i, rng); });
+    }
+
+    // Set actions[q] to the action to play at queries[q], for every query
+    void act(const std::vector<Query>& queries, std::vector<int>& actions, Rng& rng) const {
+        std::vector<int> info_sets(queries.size());
+        for (size_t q = 0; q < queries.size(); ++q)
+            info_sets[q] = this->table.get_info_set(queries[q].card, queries[q].history);
+        actions.resize(queries.size());
+        this->visit([&](const auto& policy) {
+            policy.sample(info_sets.data(), queries.size(), actions.data(), rng);
+            return 0;
+        });
+    }
+};
+
+}  // namespace kuhn
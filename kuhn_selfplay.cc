@@ -0,0 +1,128 @@
+#include "kuhn.h"
+#include "selfplay.h"
+#include "strategy_file.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+using namespace kuhn;
+
+typedef SelfPlay<KuhnTraits> Simulator;
+
+// Scripted opponents, by name:
+//   check  - never bets, so folds to every bet
+//   bet    - always bets or calls
+//   random - checks or bets with equal probability
+//   honest - bets and calls holding the king, checks and folds otherwise
+// Returns the scripted player called name, or an empty Player if there is none
+Simulator::Player get_scripted_player(const string& name) {
+    if (name == "check")
+        return [](int, int, Rng&) { return 0; };
+    if (name == "bet")
+        return [](int, int, Rng&) { return 1; };
+    if (name == "random")
+        return [](int, int, Rng& rng) { return (int) (rng() & 1); };
+    if (name == "honest")
+        return [](int card, int, Rng&) { return (card == NUM_CARDS) ? 1 : 0; };
+    return {};
+}
+
+// usage: kuhn_selfplay [--hands N] [--threads N] [--seed S] [--quantize 16|8] A B
+//
+// Plays N hands of Kuhn Poker between A and B, and reports A's results with 95% confidence
+// intervals. A player is a strategy file written by the kuhn trainer or a scripted opponent.
+// --quantize plays strategy files from a copy quantized to 16 or 8 bits per entry, rather than
+// from their mapped pages.
+int main(int argc, char** argv) {
+    long n_hands = 1000000;
+    int n_threads = max(1u, thread::hardware_concurrency());
+    uint64_t seed = 0;
+    int quantize = 0;
+    vector<string> names;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (!arg.starts_with("--")) {
+            names.push_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            cerr << "missing value for " << arg << '\n';
+            return 1;
+        }
+        string value = argv[++i];
+        try {
+            // counts below 1 are bad values too
+            if (arg == "--hands") {
+                n_hands = stol(value);
+                if (n_hands < 1)
+                    throw invalid_argument("no hands");
+            } else if (arg == "--threads") {
+                n_threads = stoi(value);
+                if (n_threads < 1)
+                    throw invalid_argument("no threads");
+            } else if (arg == "--seed") {
+                seed = stoull(value);
+            } else if (arg == "--quantize") {
+                if (value != "16" && value != "8") {
+                    cerr << "unknown quantization " << value << '\n';
+                    return 1;
+                }
+                quantize = stoi(value);
+            } else {
+                cerr << "unknown option " << arg << '\n';
+                return 1;
+            }
+        } catch (const logic_error&) {
+            cerr << "bad value for " << arg << ": " << value << '\n';
+            return 1;
+        }
+    }
+    if (names.size() != 2) {
+        cerr << "usage: kuhn_selfplay [--hands N] [--threads N] [--seed S] [--quantize 16|8] A B"
+             << '\n';
+        return 1;
+    }
+
+    Simulator simulator(n_threads, seed);
+    Simulator::Player players[2];
+    for (int p = 0; p < 2; ++p) {
+        players[p] = get_scripted_player(names[p]);
+        if (players[p])
+            continue;
+        Bot bot;
+        try {
+            StrategyImage image(names[p], GAME, NUM_ACTIONS,
+                                simulator.get_table().get_n_info_sets());
+            if (quantize == 16)
+                bot = Bot(make_shared<const Policy16>(image));
+            else if (quantize == 8)
+                bot = Bot(make_shared<const Policy8>(image));
+            else
+                bot = Bot(std::move(image));
+        } catch (const runtime_error& e) {
+            cerr << "can't load " << names[p] << ": " << e.what() << '\n';
+            return 1;
+        }
+        // the copy in the player shares the bot's policy
+        players[p] = [bot](int card, int h, Rng& rng) { return bot.act(card, h, rng); };
+    }
+
+    auto start_time = chrono::steady_clock::now();
+    MatchResult result = simulator.play(players[0], players[1], n_hands);
+    chrono::duration<double> runtime = chrono::steady_clock::now() - start_time;
+
+    cout << fixed << setprecision(4);
+    cout << names[0] << " vs " << names[1] << ", " << result.hands << " hands" << '\n';
+    cout << "Chips/hand: " << result.get_chips_per_hand() << " +- "
+         << result.get_chips_per_hand_ci() << '\n';
+    cout << "Win rate: " << result.get_win_rate() << " +- " << result.get_win_rate_ci() << '\n';
+    cout << "Runtime: " << runtime.count() << " seconds (" << setprecision(0)
+         << result.hands / runtime.count() << " hands/s)" << '\n';
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include "regret_matching.h"
+#include "rng.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Regret-matching solver for two-player zero-sum normal-form games. Payoff is any callable where
+// payoff(a, b) is player 0's utility for playing a against b; player 1 gets -payoff(a, b). All
+// state lives in the instance, so independent games can be solved side by side, e.g. one per
+// thread of a ThreadPool.
+//
+// With a compile-time NumActions the rows are std::arrays and every inner loop has a constant
+// trip count the compiler can unroll. MatrixGameSolver<> takes the action count at runtime, and
+// by default a DenseMatrix<DYNAMIC_ACTIONS> of that size.
+
+// NumActions of a game whose size is only known at runtime
+const int DYNAMIC_ACTIONS = 0;
+
+// Payoff matrix where payoff(a, b) = matrix[a][b]
+template <int NumActions>
+struct DenseMatrix {
+    std::array<std::array<double, NumActions>, NumActions> matrix;
+
+    double operator()(int a, int b) const { return this->matrix[a][b]; }
+};
+
+// Payoff matrix of a game sized at runtime, where payoff(a, b) = matrix[a * n_actions + b]
+template <>
+struct DenseMatrix<DYNAMIC_ACTIONS> {
+    int n_actions;
+    std::vector<double> matrix;
+
+    double operator()(int a, int b) const { return this->matrix[a * this->n_actions + b]; }
+};
+
+template <int NumActions = DYNAMIC_ACTIONS, class Payoff = DenseMatrix<NumActions>>
+class MatrixGameSolver {
+    static_assert(NumActions >= 0, "NumActions must be positive or DYNAMIC_ACTIONS");
+public:
+    using Row = std::conditional_t<NumActions == DYNAMIC_ACTIONS, std::vector<double>,
+                                   std::array<double, NumActions>>;
+private:
+    Payoff payoff;
+    int n_actions;
+    // per player: regrets, current strategy and cumulative strategy
+    Row regret_sum[2], strategy[2], strategy_sum[2];
+    Rng rng;
+
+    Row make_row() const {
+        if constexpr (NumActions == DYNAMIC_ACTIONS)
+            return Row(this->n_actions, 0);
+        else
+            return Row{};
+    }
+
+    // the trip count of every loop over actions, a constant for fixed-size games
+    int size() const {
+        if constexpr (NumActions == DYNAMIC_ACTIONS)
+            return this->n_actions;
+        else
+            return NumActions;
+    }
+
+    // Regret-match both players, adding the new strategies into the strategy sums
+    void update_strategies() {
+        for (int p = 0; p < 2; ++p)
+            regret_matching(this->regret_sum[p].data(), this->strategy[p].data(), 0, this->size(),
+                            this->strategy_sum[p].data(), 1);
+    }
+
+    int sample_action(int p) {
+        double r = this->rng.uniform();
+        int a = 0;
+        double cumulative_prob = 0;
+        while (a < this->size() - 1) {
+            cumulative_prob += this->strategy[p][a];
+            if (r < cumulative_prob) break;
+            ++a;
+        }
+        return a;
+    }
+public:
+    explicit MatrixGameSolver(Payoff payoff, int n_actions = NumActions, uint64_t seed = 0) :
+        payoff(std::move(payoff)), n_actions(n_actions), rng(seed) {
+        this->reset();
+    }
+
+    // Forget everything learned so far
+    void reset() {
+        for (int p = 0; p < 2; ++p)
+            this->regret_sum[p] = this->strategy[p] = this->strategy_sum[p] = this->make_row();
+    }
+
+    int get_n_actions() const { return this->size(); }
+
+    // Run n_iterations iterations, updating regrets from one sampled action per player
+    void train_sampled(int n_iterations) {
+        int n = this->size();
+        for (int i = 0; i < n_iterations; ++i) {
+            this->update_strategies();
+            int a0 = this->sample_action(0);
+            int a1 = this->sample_action(1);
+
+            double u0 = this->payoff(a0, a1);
+            for (int a = 0; a < n; ++a) {
+                this->regret_sum[0][a] += this->payoff(a, a1) - u0;
+                this->regret_sum[1][a] += u0 - this->payoff(a0, a);
+            }
+        }
+    }
+
+    // Run n_iterations iterations, updating regrets against the opponent's whole current
+    // strategy. Both players' expected utilities come out of one pass over the action pairs.
+    void train_full_width(int n_iterations) {
+        int n = this->size();
+        Row v0 = this->make_row(), v1 = this->make_row();
+        for (int i = 0; i < n_iterations; ++i) {
+            this->update_strategies();
+
+            for (int a = 0; a < n; ++a)
+                v0[a] = v1[a] = 0;
+            for (int a = 0; a < n; ++a) {
+                for (int b = 0; b < n; ++b) {
+                    double u = this->payoff(a, b);
+                    v0[a] += this->strategy[1][b] * u;
+                    v1[b] -= this->strategy[0][a] * u;
+                }
+            }
+
+            double value0 = 0, value1 = 0;
+            for (int a = 0; a < n; ++a) {
+                value0 += this->strategy[0][a] * v0[a];
+                value1 += this->strategy[1][a] * v1[a];
+            }
+            for (int a = 0; a < n; ++a) {
+                this->regret_sum[0][a] += v0[a] - value0;
+                this->regret_sum[1][a] += v1[a] - value1;
+            }
+        }
+    }
+
+    // Returns player p's average strategy over all iterations so far
+    Row get_average_strategy(int p) const {
+        Row res = this->make_row();
+        double norm = 0;
+        for (int a = 0; a < this->size(); ++a)
+            norm += this->strategy_sum[p][a];
+        for (int a = 0; a < this->size(); ++a)
+            res[a] = (norm > 0) ? this->strategy_sum[p][a] / norm : 1.0 / this->size();
+        return res;
+    }
+
+    // Returns player 0's expected utility when both players play their average strategies
+    double get_expected_value() const {
+        Row s0 = this->get_average_strategy(0), s1 = this->get_average_strategy(1);
+        double value = 0;
+        for (int a = 0; a < this->size(); ++a)
+            for (int b = 0; b < this->size(); ++b)
+                value += s0[a] * s1[b] * this->payoff(a, b);
+        return value;
+    }
+
+    // Returns the exploitability of the average strategies: the mean of what each player gains by
+    // best responding to the other. It is zero exactly at a Nash equilibrium.
+    double get_exploitability() const {
+        Row s0 = this->get_average_strategy(0), s1 = this->get_average_strategy(1);
+        Row v0 = this->make_row(), v1 = this->make_row();
+        for (int a = 0; a < this->size(); ++a) {
+            for (int b = 0; b < this->size(); ++b) {
+                double u = this->payoff(a, b);
+                v0[a] += s1[b] * u;
+                v1[b] -= s0[a] * u;
+            }
+        }
+        double best0 = v0[0], best1 = v1[0];
+        for (int a = 1; a < this->size(); ++a) {
+            best0 = std::max(best0, v0[a]);
+            best1 = std::max(best1, v1[a]);
+        }
+        // the game value cancels out of the sum of both players' gains
+        return (best0 + best1) / 2;
+    }
+};
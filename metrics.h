@@ -0,0 +1,203 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+// Training progress reports, streamed to a writer thread so that the training thread never
+// formats, writes or waits for I/O. The training thread pushes fixed-size Metrics into a lock-free
+// ring and carries on; if the writer falls a whole ring behind, reports are dropped, not waited
+// for.
+
+// One progress report. Anything not measured is NaN, and left out of the output.
+struct Metrics {
+    long iteration = 0;
+    // wall time since reporting started
+    double seconds = 0;
+    // rates over the iterations since the previous report
+    double iterations_per_second = NAN, nodes_per_second = NAN;
+    // player 1's utility averaged over the iterations since the previous report
+    double utility = NAN;
+    double exploitability = NAN;
+};
+
+enum class MetricsFormat { TEXT, CSV, JSON };
+
+// Bounded single-producer single-consumer queue. push and pop each touch one index the other side
+// only reads, so neither ever blocks or takes a lock. Capacity must be a power of two.
+template <class T, std::size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "Capacity must be a power of two");
+private:
+    T items[Capacity];
+    // items are pushed at head and popped at tail, both counting up forever; on their own cache
+    // lines so that the two threads don't contend for one
+    alignas(64) std::atomic<std::size_t> head = 0;
+    alignas(64) std::atomic<std::size_t> tail = 0;
+public:
+    // Add item, from the producer thread. Returns false if the queue is full.
+    bool push(const T& item) {
+        std::size_t h = this->head.load(std::memory_order_relaxed);
+        if (h - this->tail.load(std::memory_order_acquire) == Capacity)
+            return false;
+        this->items[h % Capacity] = item;
+        this->head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Move the oldest item to item, from the consumer thread. Returns false if the queue is empty.
+    bool pop(T& item) {
+        std::size_t t = this->tail.load(std::memory_order_relaxed);
+        if (t == this->head.load(std::memory_order_acquire))
+            return false;
+        item = this->items[t % Capacity];
+        this->tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+// Writes pushed Metrics to a stream on its own thread, as aligned text, CSV with a header row, or
+// one JSON object per line. A sink has a single producer: one training loop pushes into it.
+class MetricsSink {
+private:
+    static constexpr std::size_t CAPACITY = 1024;
+    // how long the writer sleeps when it finds the queue empty
+    static constexpr std::chrono::milliseconds POLL{10};
+
+    SpscQueue<Metrics, CAPACITY> queue;
+    std::ofstream file;
+    std::ostream* out;
+    MetricsFormat format;
+    // reports pushed by the producer, and written by the writer
+    long pushed = 0, dropped = 0;
+    std::atomic<long> written = 0;
+    std::atomic<bool> stopping = false;
+    std::thread writer;
+
+    // Write value to line as a member named name, or nothing if it is NaN
+    static void write_text(std::ostream& line, const char* name, double value, int precision) {
+        if (!std::isnan(value))
+            line << "  " << name << " " << std::setprecision(precision) << value;
+    }
+
+    static void write_csv(std::ostream& line, double value) {
+        line << ',';
+        if (!std::isnan(value))
+            line << value;
+    }
+
+    static void write_json(std::ostream& line, const char* name, double value) {
+        line << ", \"" << name << "\": ";
+        if (std::isnan(value))
+            line << "null";
+        else
+            line << value;
+    }
+
+    // Write m, formatted on its own stream so that the output stream's flags are left alone
+    void write(const Metrics& m) {
+        std::ostringstream out;
+        if (this->format == MetricsFormat::TEXT) {
+            out << std::fixed << "iteration " << m.iteration;
+            write_text(out, "time", m.seconds, 2);
+            write_text(out, "it/s", m.iterations_per_second, 0);
+            write_text(out, "nodes/s", m.nodes_per_second, 0);
+            write_text(out, "utility", m.utility, 6);
+            write_text(out, "exploitability", m.exploitability, 6);
+            out << '\n';
+        } else if (this->format == MetricsFormat::CSV) {
+            out << std::setprecision(10) << m.iteration;
+            for (double value : {m.seconds, m.iterations_per_second, m.nodes_per_second,
+                                 m.utility, m.exploitability})
+                write_csv(out, value);
+            out << '\n';
+        } else {
+            out << std::setprecision(10) << "{\"iteration\": " << m.iteration;
+            write_json(out, "seconds", m.seconds);
+            write_json(out, "iterations_per_second", m.iterations_per_second);
+            write_json(out, "nodes_per_second", m.nodes_per_second);
+            write_json(out, "utility", m.utility);
+            write_json(out, "exploitability", m.exploitability);
+            out << "}\n";
+        }
+        *this->out << out.str();
+    }
+
+    void run() {
+        if (this->format == MetricsFormat::CSV)
+            *this->out << "iteration,seconds,iterations_per_second,nodes_per_second,utility,"
+                       << "exploitability\n";
+        Metrics m;
+        while (true) {
+            // read stopping first, so that nothing pushed before it was set is left behind
+            bool stop = this->stopping.load(std::memory_order_acquire);
+            long n = 0;
+            while (this->queue.pop(m)) {
+                this->write(m);
+                ++n;
+            }
+            if (n > 0) {
+                this->out->flush();
+                this->written.fetch_add(n, std::memory_order_release);
+            }
+            if (stop)
+                return;
+            if (n == 0)
+                std::this_thread::sleep_for(POLL);
+        }
+    }
+public:
+    // Write to out, which must outlive the sink
+    MetricsSink(std::ostream& out, MetricsFormat format) : out(&out), format(format) {
+        this->writer = std::thread(&MetricsSink::run, this);
+    }
+
+    // Write to the file at path, replacing it
+    MetricsSink(const std::string& path, MetricsFormat format) :
+        file(path), out(&this->file), format(format) {
+        if (!this->file)
+            throw std::runtime_error("can't open " + path);
+        this->writer = std::thread(&MetricsSink::run, this);
+    }
+
+    MetricsSink(const MetricsSink&) = delete;
+    MetricsSink& operator=(const MetricsSink&) = delete;
+
+    // Writes everything pushed so far
+    ~MetricsSink() {
+        this->stopping.store(true, std::memory_order_release);
+        this->writer.join();
+    }
+
+    // Queue m to be written, from the producer thread. Returns false, dropping m, if the writer
+    // is a whole queue behind.
+    bool push(const Metrics& m) {
+        if (!this->queue.push(m)) {
+            ++this->dropped;
+            return false;
+        }
+        ++this->pushed;
+        return true;
+    }
+
+    // Block until everything pushed so far is written, from the producer thread. Call it before
+    // writing anything else to the same stream.
+    void flush() {
+        while (this->written.load(std::memory_order_acquire) < this->pushed)
+            std::this_thread::sleep_for(POLL / 10);
+    }
+
+    // Returns the number of reports dropped because the queue was full, from the producer thread
+    long get_dropped() const {
+        return this->dropped;
+    }
+};
@@ -0,0 +1,189 @@
+#pragma once
+
+#include "rng.h"
+#include "strategy_file.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Set actions[q] to an action policy samples at information set info_sets[q], for q < n. The
+// draws are made in bulk, a block at a time, ahead of the table lookups.
+template <class P>
+void sample_actions(const P& policy, const int* info_sets, int n, int* actions, Rng& rng) {
+    const int BLOCK = 256;
+    double r[BLOCK];
+    for (int first = 0; first < n; first += BLOCK) {
+        int m = std::min(BLOCK, n - first);
+        rng.fill_uniform(r, m);
+        for (int q = 0; q < m; ++q)
+            actions[first + q] = policy.sample(info_sets[first + q], r[q]);
+    }
+}
+
+// Frozen average strategy, for serving moves rather than training. Every information set's row is
+// stored as its cumulative distribution, so sampling an action is one scan of a contiguous row for
+// the first entry above a uniform draw, with no normalizing on the serving path. A policy is
+// immutable once built, so any number of threads can sample from one, each with its own rng.
+//
+// Entry is the type the distribution is held in. An unsigned integer type quantizes it to steps
+// of 1 / max(Entry), so Policy16 and Policy8 take a quarter and an eighth of the memory of
+// Policy. Each action's probability is then off by less than one step, and one far below a step
+// may never be played.
+template <class Entry>
+class BasicPolicy {
+private:
+    // the entry standing for probability 1
+    static constexpr double ONE = std::is_integral_v<Entry> ? std::numeric_limits<Entry>::max() : 1;
+
+    int n_actions = 0, n_info_sets = 0;
+    // cdf[i * n_actions + a] = probability of playing an action up to a at information set i,
+    // times ONE. Every entry from the last action with any probability on is exactly ONE, so a
+    // draw from [0, 1) always stops on an action that can be played.
+    std::vector<Entry> cdf;
+public:
+    BasicPolicy() = default;
+
+    // Build from rows of average_strategy, n_actions wide, one per information set
+    BasicPolicy(const double* average_strategy, int n_info_sets, int n_actions) :
+        n_actions(n_actions), n_info_sets(n_info_sets),
+        cdf((size_t) n_info_sets * n_actions) {
+        for (int i = 0; i < n_info_sets; ++i) {
+            const double* strategy = average_strategy + (size_t) i * n_actions;
+            Entry* row = &this->cdf[(size_t) i * n_actions];
+            double cumulative = 0;
+            int last = 0;
+            for (int a = 0; a < n_actions; ++a) {
+                cumulative += strategy[a];
+                double entry = std::min(cumulative, 1.0) * ONE;
+                row[a] = std::is_integral_v<Entry> ? std::round(entry) : entry;
+                if (strategy[a] > 0)
+                    last = a;
+            }
+            std::fill(row + last, row + n_actions, static_cast<Entry>(ONE));
+        }
+    }
+
+    // Copy the average strategy of image, e.g. to quantize it; ImagePolicy serves it in place
+    explicit BasicPolicy(const StrategyImage& image) :
+        BasicPolicy(image.get_average_strategy(), image.get_header().n_info_sets,
+               image.get_header().n_actions) {}
+
+    int get_n_actions() const { return this->n_actions; }
+
+    int get_n_info_sets() const { return this->n_info_sets; }
+
+    // Returns the probability of playing action a at information set i, as quantized
+    double get_probability(int i, int a) const {
+        const Entry* row = &this->cdf[(size_t) i * this->n_actions];
+        return ((double) row[a] - ((a == 0) ? 0 : (double) row[a - 1])) / ONE;
+    }
+
+    // Returns the action played at information set i for a uniform draw r in [0, 1)
+    int sample(int i, double r) const {
+        const Entry* row = &this->cdf[(size_t) i * this->n_actions];
+        double x = r * ONE;
+        int a = 0;
+        while (x >= row[a])
+            ++a;
+        return a;
+    }
+
+    int sample(int i, Rng& rng) const {
+        return this->sample(i, rng.uniform());
+    }
+
+    // Set actions[q] to an action sampled at information set info_sets[q], for q < n
+    void sample(const int* info_sets, int n, int* actions, Rng& rng) const {
+        sample_actions(*this, info_sets, n, actions, rng);
+    }
+};
+
+typedef BasicPolicy<double> Policy;
+typedef BasicPolicy<uint16_t> Policy16;
+typedef BasicPolicy<uint8_t> Policy8;
+
+// Average strategy of a mapped strategy file, served in place: every process serving the same
+// file reads the same physical pages, and loading it copies nothing. Sampling sums a row's
+// probabilities as it scans it, where a Policy reads them precomputed, so it plays the same
+// actions as a Policy of the file for the same draws, up to rounding. Immutable like a Policy.
+class ImagePolicy {
+private:
+    StrategyImage image;
+    const double* average_strategy = nullptr;
+    int n_actions = 0, n_info_sets = 0;
+public:
+    ImagePolicy() = default;
+
+    explicit ImagePolicy(StrategyImage image) :
+        image(std::move(image)), average_strategy(this->image.get_average_strategy()),
+        n_actions(this->image.get_header().n_actions),
+        n_info_sets(this->image.get_header().n_info_sets) {}
+
+    int get_n_actions() const { return this->n_actions; }
+
+    int get_n_info_sets() const { return this->n_info_sets; }
+
+    // Returns the action played at information set i for a uniform draw r in [0, 1). A draw
+    // past the row's rounded total plays its last action with any probability on.
+    int sample(int i, double r) const {
+        const double* row = this->average_strategy + (size_t) i * this->n_actions;
+        double cumulative = 0;
+        int last = 0;
+        for (int a = 0; a < this->n_actions; ++a) {
+            if (row[a] <= 0)
+                continue;
+            cumulative += row[a];
+            if (r < cumulative)
+                return a;
+            last = a;
+        }
+        return last;
+    }
+
+    int sample(int i, Rng& rng) const {
+        return this->sample(i, rng.uniform());
+    }
+
+    // Set actions[q] to an action sampled at information set info_sets[q], for q < n
+    void sample(const int* info_sets, int n, int* actions, Rng& rng) const {
+        sample_actions(*this, info_sets, n, actions, rng);
+    }
+};
+
+// The latest published snapshot of a policy, shared read-only by every game and thread. Readers
+// take the current snapshot, which stays alive for as long as any of them holds it, and a
+// trainer publishes newer ones without waiting for them; the last holder of an old snapshot
+// frees it. The lock only guards the pointer copy, which is what std::atomic<std::shared_ptr>
+// does in libstdc++ too. Take a snapshot once per hand or batch rather than once per move.
+template <class P = Policy>
+class PolicySlot {
+private:
+    mutable std::mutex mutex;
+    std::shared_ptr<const P> current;
+public:
+    PolicySlot() = default;
+
+    explicit PolicySlot(std::shared_ptr<const P> policy) : current(std::move(policy)) {}
+
+    // Replace the current snapshot. Readers holding the old one keep it, and whoever drops it
+    // last frees it, outside the lock.
+    void publish(std::shared_ptr<const P> policy) {
+        {
+            std::lock_guard lock(this->mutex);
+            this->current.swap(policy);
+        }
+    }
+
+    // Returns the current snapshot, or null if none has been published
+    std::shared_ptr<const P> get() const {
+        std::lock_guard lock(this->mutex);
+        return this->current;
+    }
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Regret matching kernels shared by the solvers. Each works on a row of actions [lo, hi): the
+// strategy is the positive part of the regrets normalized to sum to one, or uniform over the row
+// if no regret is positive. Rows are processed 4 (AVX2) or 2 (NEON) actions at a time, with a
+// scalar loop for the remainder and for other targets. Regrets may be stored as float or double;
+// strategies are always computed in double.
+
+#if defined(__AVX2__)
+inline __m256d load_regrets(const double* regret) { return _mm256_loadu_pd(regret); }
+
+inline __m256d load_regrets(const float* regret) { return _mm256_cvtps_pd(_mm_loadu_ps(regret)); }
+#elif defined(__ARM_NEON)
+inline float64x2_t load_regrets(const double* regret) { return vld1q_f64(regret); }
+
+inline float64x2_t load_regrets(const float* regret) { return vcvt_f64_f32(vld1_f32(regret)); }
+#endif
+
+// Returns the sum of max(regret[a], 0) over [lo, hi), writing each max(regret[a], 0) to strategy
+template <class Real>
+inline double regret_matching_positive(const Real* regret, double* strategy, int lo, int hi) {
+    int a = lo;
+    double norm = 0;
+#if defined(__AVX2__)
+    __m256d zero = _mm256_setzero_pd(), sum = zero;
+    for (; a + 4 <= hi; a += 4) {
+        __m256d r = _mm256_max_pd(load_regrets(regret + a), zero);
+        _mm256_storeu_pd(strategy + a, r);
+        sum = _mm256_add_pd(sum, r);
+    }
+    __m128d half = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+    norm = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+#elif defined(__ARM_NEON)
+    float64x2_t zero = vdupq_n_f64(0), sum = zero;
+    for (; a + 2 <= hi; a += 2) {
+        float64x2_t r = vmaxq_f64(load_regrets(regret + a), zero);
+        vst1q_f64(strategy + a, r);
+        sum = vaddq_f64(sum, r);
+    }
+    norm = vaddvq_f64(sum);
+#endif
+    for (; a < hi; ++a) {
+        strategy[a] = (regret[a] > 0) ? regret[a] : 0;
+        norm += strategy[a];
+    }
+    return norm;
+}
+
+// Compute the regret-matching strategy of one row, adding weight * strategy into strategy_sum
+// unless it is null
+template <class Real>
+inline void regret_matching(const Real* regret, double* strategy, int lo, int hi,
+                            double* strategy_sum = nullptr, double weight = 0) {
+    double norm = regret_matching_positive(regret, strategy, lo, hi);
+    double scale = (norm > 0) ? 1 / norm : 0;
+    double uniform = (norm > 0) ? 0 : 1.0 / (hi - lo);
+
+    int a = lo;
+#if defined(__AVX2__)
+    __m256d s = _mm256_set1_pd(scale), u = _mm256_set1_pd(uniform), w = _mm256_set1_pd(weight);
+    for (; a + 4 <= hi; a += 4) {
+        __m256d p = _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(strategy + a), s), u);
+        _mm256_storeu_pd(strategy + a, p);
+        if (strategy_sum) {
+            __m256d sum = _mm256_loadu_pd(strategy_sum + a);
+            _mm256_storeu_pd(strategy_sum + a, _mm256_add_pd(sum, _mm256_mul_pd(w, p)));
+        }
+    }
+#elif defined(__ARM_NEON)
+    float64x2_t s = vdupq_n_f64(scale), u = vdupq_n_f64(uniform), w = vdupq_n_f64(weight);
+    for (; a + 2 <= hi; a += 2) {
+        float64x2_t p = vaddq_f64(vmulq_f64(vld1q_f64(strategy + a), s), u);
+        vst1q_f64(strategy + a, p);
+        if (strategy_sum)
+            vst1q_f64(strategy_sum + a, vfmaq_f64(vld1q_f64(strategy_sum + a), w, p));
+    }
+#endif
+    for (; a < hi; ++a) {
+        strategy[a] = strategy[a] * scale + uniform;
+        if (strategy_sum)
+            strategy_sum[a] += weight * strategy[a];
+    }
+}
+
+// Compute the regret-matching strategy of n_rows rows of width stride at once. Row i covers
+// actions [lo[i], hi[i]), or the whole row when lo and hi are null.
+template <class Real>
+inline void regret_matching_rows(const Real* regret, double* strategy, int n_rows, int stride,
+                                 const int* lo = nullptr, const int* hi = nullptr) {
+    for (int i = 0; i < n_rows; ++i) {
+        int offset = i * stride;
+        regret_matching(regret + offset, strategy + offset, lo ? lo[i] : 0, hi ? hi[i] : stride);
+    }
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Random streams for the samplers. xoshiro256** is a handful of shifts, rotates and xors per
+// draw, with 256 bits of state and period 2^256 - 1, so every thread can own a stream and draw
+// millions of samples per second with no shared state. It satisfies UniformRandomBitGenerator,
+// so it also works with the <random> distributions.
+class Xoshiro256 {
+private:
+    // number of streams fill_uniform draws from side by side
+    static const int LANES = 8;
+
+    uint64_t s[4];
+    // lanes[i][k] = word i of bulk lane k, set up by the first fill_uniform since the stream was
+    // seeded or jumped. Lane k is the stream long-jumped k + 1 times, far past anything jump()
+    // hands out, and the words are stored lane by lane so one step of every lane vectorizes.
+    uint64_t lanes[4][LANES] = {};
+    bool has_lanes = false;
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    // Replace the state with that of the stream advanced by the jump polynomial poly
+    void advance(const uint64_t (&poly)[4]) {
+        uint64_t t[4] = {};
+        for (uint64_t word : poly)
+            for (int b = 0; b < 64; ++b) {
+                if (word & (uint64_t) 1 << b)
+                    for (int i = 0; i < 4; ++i)
+                        t[i] ^= this->s[i];
+                (*this)();
+            }
+        for (int i = 0; i < 4; ++i)
+            this->s[i] = t[i];
+        this->has_lanes = false;
+    }
+
+    // Advance by 2^192 draws
+    void long_jump() {
+        const uint64_t LONG_JUMP[4] = {0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL,
+                                       0x77710069854ee241ULL, 0x39109bb02acbe635ULL};
+        this->advance(LONG_JUMP);
+    }
+
+    void set_up_lanes() {
+        Xoshiro256 lane = *this;
+        for (int k = 0; k < LANES; ++k) {
+            lane.long_jump();
+            for (int i = 0; i < 4; ++i)
+                this->lanes[i][k] = lane.s[i];
+        }
+        this->has_lanes = true;
+    }
+
+    // SplitMix64, which spreads a 64-bit seed over the state so that nearby seeds give
+    // unrelated streams
+    static uint64_t split_mix(uint64_t& x) {
+        uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+public:
+    using result_type = uint64_t;
+
+    explicit Xoshiro256(uint64_t seed = 0) { this->seed(seed); }
+
+    void seed(uint64_t seed) {
+        for (uint64_t& word : this->s)
+            word = split_mix(seed);
+        this->has_lanes = false;
+    }
+
+    static constexpr result_type min() { return 0; }
+
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()() {
+        uint64_t res = rotl(this->s[1] * 5, 7) * 9;
+        uint64_t t = this->s[1] << 17;
+        this->s[2] ^= this->s[0];
+        this->s[3] ^= this->s[1];
+        this->s[1] ^= this->s[2];
+        this->s[0] ^= this->s[3];
+        this->s[2] ^= t;
+        this->s[3] = rotl(this->s[3], 45);
+        return res;
+    }
+
+    // Returns a uniform double in [0, 1), from the top 53 bits of a draw
+    double uniform() { return ((*this)() >> 11) * 0x1.0p-53; }
+
+    // Returns a uniform integer in [0, n). Multiplying instead of taking a remainder leaves a
+    // bias of at most n / 2^64.
+    int below(int n) { return (int) (((unsigned __int128) (*this)() * n) >> 64); }
+
+    // Fill out with n uniform doubles in [0, 1), from LANES streams stepped side by side. A draw's
+    // top 52 bits become the mantissa of a double in [1, 2), which needs no integer conversion.
+    // The lanes are stepped 4 at a time with AVX2, in two independent groups so that one's
+    // latency hides the other's, and by a scalar loop giving the same draws on other targets.
+    // Any remainder of n comes from uniform().
+    void fill_uniform(double* out, std::size_t n) {
+        if (n < LANES) {
+            for (std::size_t i = 0; i < n; ++i)
+                out[i] = this->uniform();
+            return;
+        }
+        if (!this->has_lanes)
+            this->set_up_lanes();
+        std::size_t n_steps = n / LANES;
+#if defined(__AVX2__)
+        static_assert(LANES == 8, "the kernel steps two groups of 4 lanes");
+        __m256i s[2][4];
+        for (int g = 0; g < 2; ++g)
+            for (int i = 0; i < 4; ++i)
+                s[g][i] = _mm256_loadu_si256((const __m256i*) &this->lanes[i][4 * g]);
+        const __m256i exponent = _mm256_set1_epi64x(0x3ff0000000000000LL);
+        const __m256d one = _mm256_set1_pd(1);
+        for (std::size_t step = 0; step < n_steps; ++step)
+            for (int g = 0; g < 2; ++g) {
+                __m256i* w = s[g];
+                // rotl(s1 * 5, 7) * 9, multiplying by shifts and adds
+                __m256i m = _mm256_add_epi64(_mm256_slli_epi64(w[1], 2), w[1]);
+                m = _mm256_or_si256(_mm256_slli_epi64(m, 7), _mm256_srli_epi64(m, 57));
+                __m256i res = _mm256_add_epi64(_mm256_slli_epi64(m, 3), m);
+                __m256i t = _mm256_slli_epi64(w[1], 17);
+                w[2] = _mm256_xor_si256(w[2], w[0]);
+                w[3] = _mm256_xor_si256(w[3], w[1]);
+                w[1] = _mm256_xor_si256(w[1], w[2]);
+                w[0] = _mm256_xor_si256(w[0], w[3]);
+                w[2] = _mm256_xor_si256(w[2], t);
+                w[3] = _mm256_or_si256(_mm256_slli_epi64(w[3], 45), _mm256_srli_epi64(w[3], 19));
+                __m256i bits = _mm256_or_si256(_mm256_srli_epi64(res, 12), exponent);
+                _mm256_storeu_pd(out + step * LANES + 4 * g,
+                                 _mm256_sub_pd(_mm256_castsi256_pd(bits), one));
+            }
+        for (int g = 0; g < 2; ++g)
+            for (int i = 0; i < 4; ++i)
+                _mm256_storeu_si256((__m256i*) &this->lanes[i][4 * g], s[g][i]);
+#else
+        for (std::size_t step = 0; step < n_steps; ++step)
+            for (int k = 0; k < LANES; ++k) {
+                uint64_t* w[4] = {&this->lanes[0][k], &this->lanes[1][k], &this->lanes[2][k],
+                                  &this->lanes[3][k]};
+                uint64_t res = rotl(*w[1] * 5, 7) * 9;
+                uint64_t t = *w[1] << 17;
+                *w[2] ^= *w[0];
+                *w[3] ^= *w[1];
+                *w[1] ^= *w[2];
+                *w[0] ^= *w[3];
+                *w[2] ^= t;
+                *w[3] = rotl(*w[3], 45);
+                out[step * LANES + k] =
+                    std::bit_cast<double>(0x3ff0000000000000ULL | res >> 12) - 1;
+            }
+#endif
+        for (std::size_t i = n_steps * LANES; i < n; ++i)
+            out[i] = this->uniform();
+    }
+
+    // Advance the stream by 2^128 draws. Calling it k times on copies of one stream gives k
+    // streams that never overlap.
+    void jump() {
+        const uint64_t JUMP[4] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                  0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+        this->advance(JUMP);
+    }
+};
+
+// the generator every sampler draws from; any UniformRandomBitGenerator with uniform(), below()
+// and fill_uniform() can take its place
+typedef Xoshiro256 Rng;
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "matrix_game.h"
+
+// Rock paper scissors as a matrix game
+
+namespace rps {
+
+const int NUM_ACTIONS = 3;
+
+// UTILITY[a][b] = utility of playing a against b, where 0 = rock, 1 = paper, 2 = scissors
+const DenseMatrix<NUM_ACTIONS> UTILITY = {{{
+    { 0, -1,  1},
+    { 1,  0, -1},
+    {-1,  1,  0},
+}}};
+
+typedef MatrixGameSolver<NUM_ACTIONS> Solver;
+
+}  // namespace rps
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "cfr.h"
+#include "rng.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+
+// Headless self-play for any game that plugs into cfr.h: plays hands between two players across
+// a thread pool, with no terminal I/O, and tallies the results from the first player's side.
+
+// z-score of a two-sided 95% confidence interval
+const double Z_95 = 1.96;
+
+// Tally of a match, from player A's side
+struct MatchResult {
+    long hands = 0, wins = 0, losses = 0;
+    // sum of A's winnings over every hand, and of their squares
+    double chips = 0, chips_squared = 0;
+
+    void add(double u) {
+        ++this->hands;
+        this->wins += (u > 0);
+        this->losses += (u < 0);
+        this->chips += u;
+        this->chips_squared += u * u;
+    }
+
+    MatchResult& operator+=(const MatchResult& other) {
+        this->hands += other.hands;
+        this->wins += other.wins;
+        this->losses += other.losses;
+        this->chips += other.chips;
+        this->chips_squared += other.chips_squared;
+        return *this;
+    }
+
+    double get_chips_per_hand() const { return this->chips / this->hands; }
+
+    // Returns the half width of the 95% confidence interval of get_chips_per_hand
+    double get_chips_per_hand_ci() const {
+        double mean = this->get_chips_per_hand();
+        double variance = std::max(this->chips_squared / this->hands - mean * mean, 0.0);
+        return Z_95 * std::sqrt(variance / this->hands);
+    }
+
+    // Returns the fraction of hands A won outright
+    double get_win_rate() const { return (double) this->wins / this->hands; }
+
+    // Returns the half width of the 95% confidence interval of get_win_rate
+    double get_win_rate_ci() const {
+        double p = this->get_win_rate();
+        return Z_95 * std::sqrt(p * (1 - p) / this->hands);
+    }
+};
+
+template <class Traits>
+class SelfPlay {
+public:
+    using Table = typename Traits::Table;
+    // Returns the action to play holding private state x after history h. Players are called
+    // from every thread at once, so they must not write shared state; rng is the calling
+    // thread's own stream.
+    typedef std::function<int(int x, int h, Rng& rng)> Player;
+private:
+    Table table;
+    std::vector<Deal> deals;
+    // cumulative chance probability of every deal
+    std::vector<double> chance_cdf;
+    ThreadPool pool;
+    uint64_t seed;
+    // matches played so far, so that every match draws fresh streams
+    long n_matches = 0;
+
+    const Deal& sample_deal(Rng& rng) const {
+        double r = rng.uniform();
+        int d = std::upper_bound(this->chance_cdf.begin(), this->chance_cdf.end(), r) -
+                this->chance_cdf.begin();
+        return this->deals[std::min<int>(d, this->deals.size() - 1)];
+    }
+
+    // Play one hand of deal with players[p] in seat p. Returns seat 0's winnings.
+    double play_hand(const Deal& deal, const Player* players[2], Rng& rng) const {
+        int h = Table::ROOT;
+        while (!this->table.is_terminal(h)) {
+            int p = this->table.get_player(h);
+            h = this->table.get_child(h, (*players[p])(deal[p], h, rng));
+        }
+        double u = this->table.get_utility(h, deal);
+        return (this->table.get_player(h) == 0) ? u : -u;
+    }
+public:
+    explicit SelfPlay(int n_threads = 1, uint64_t seed = 0) :
+        pool(std::max(n_threads, 1)), seed(seed) {
+        this->deals = Traits::get_deals();
+        double total = 0;
+        for (const Deal& deal : this->deals)
+            total += Traits::get_weight(deal);
+        double cumulative = 0;
+        for (const Deal& deal : this->deals) {
+            cumulative += Traits::get_weight(deal) / total;
+            this->chance_cdf.push_back(cumulative);
+        }
+    }
+
+    // Play n_hands between a and b, who swap seats every hand so that neither gains from
+    // position. Each thread plays its share of the hands from its own stream, so the result
+    // depends only on the seed, the thread count and the number of matches played before.
+    MatchResult play(const Player& a, const Player& b, long n_hands) {
+        std::vector<MatchResult> results(this->pool.size());
+        long match = this->n_matches++;
+        this->pool.run([&](int t) {
+            Rng rng(this->seed + t + match * this->pool.size());
+            long first = n_hands * t / this->pool.size();
+            long last = n_hands * (t + 1) / this->pool.size();
+            // tallied locally, so that threads don't write to neighbouring results every hand
+            MatchResult result;
+            for (long i = first; i < last; ++i) {
+                const Deal& deal = this->sample_deal(rng);
+                bool swapped = i % 2;
+                const Player* players[2] = {swapped ? &b : &a, swapped ? &a : &b};
+                double u = this->play_hand(deal, players, rng);
+                result.add(swapped ? -u : u);
+            }
+            results[t] = result;
+        });
+
+        MatchResult total;
+        for (const MatchResult& result : results)
+            total += result;
+        return total;
+    }
+
+    const Table& get_table() const {
+        return this->table;
+    }
+};
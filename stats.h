@@ -0,0 +1,125 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Hot-path instrumentation for the solvers. Build with -DCFR_STATS to count, and with
+// -DCFR_STATS_TIMERS to also time the instrumented scopes. Without them, every Stats call and
+// ScopedTimer compiles to nothing.
+//
+// Each training thread counts into its own Stats, on its own cache line, so counting never
+// contends; the solver sums them when asked.
+
+#if defined(CFR_STATS) || defined(CFR_STATS_TIMERS)
+constexpr bool STATS_ENABLED = true;
+#else
+constexpr bool STATS_ENABLED = false;
+#endif
+
+#ifdef CFR_STATS_TIMERS
+constexpr bool STATS_TIMERS_ENABLED = true;
+#else
+constexpr bool STATS_TIMERS_ENABLED = false;
+#endif
+
+enum class Counter {
+    // calls of a traversal on any history, terminal or not
+    NODE_VISITS,
+    // terminal payoffs read, once per terminal visit (once per payoff matrix on the public tree)
+    TERMINAL_EVALUATIONS,
+    // information set rows looked up by get_node
+    NODE_LOOKUPS,
+    // actions skipped by regret-based pruning
+    PRUNED_SUBTREES,
+    // histories in the subtrees skipped by pruning, which a full-width walk would have visited
+    PRUNED_HISTORIES,
+};
+const int N_COUNTERS = 5;
+const char* const COUNTER_NAMES[N_COUNTERS] = {"node_visits", "terminal_evaluations",
+                                               "node_lookups", "pruned_subtrees",
+                                               "pruned_histories"};
+
+enum class Timer {
+    // whole cfr traversals, from the root
+    CFR,
+    GET_NODE,
+    // whole compute_terminal_payoffs traversals, from the root
+    TERMINAL_PAYOFFS,
+};
+const int N_TIMERS = 3;
+const char* const TIMER_NAMES[N_TIMERS] = {"cfr", "get_node", "compute_terminal_payoffs"};
+
+struct alignas(64) Stats {
+    std::array<uint64_t, N_COUNTERS> counts = {};
+    // total time and number of calls of every timed scope
+    std::array<uint64_t, N_TIMERS> nanoseconds = {}, calls = {};
+
+    void add(Counter c, uint64_t n = 1) {
+        if constexpr (STATS_ENABLED)
+            this->counts[static_cast<int>(c)] += n;
+    }
+
+    void add_time(Timer t, uint64_t ns) {
+        if constexpr (STATS_TIMERS_ENABLED) {
+            this->nanoseconds[static_cast<int>(t)] += ns;
+            ++this->calls[static_cast<int>(t)];
+        }
+    }
+
+    uint64_t get(Counter c) const { return this->counts[static_cast<int>(c)]; }
+
+    Stats& operator+=(const Stats& other) {
+        for (int i = 0; i < N_COUNTERS; ++i)
+            this->counts[i] += other.counts[i];
+        for (int i = 0; i < N_TIMERS; ++i) {
+            this->nanoseconds[i] += other.nanoseconds[i];
+            this->calls[i] += other.calls[i];
+        }
+        return *this;
+    }
+
+    // Write the counters, and the timers if they are compiled in, as the members of a JSON object
+    void write_json(std::ostream& out) const {
+        for (int i = 0; i < N_COUNTERS; ++i)
+            out << "\"" << COUNTER_NAMES[i] << "\": " << this->counts[i] << ", ";
+        out << "\"timers\": {";
+        if constexpr (STATS_TIMERS_ENABLED)
+            for (int i = 0; i < N_TIMERS; ++i)
+                out << ((i > 0) ? ", " : "") << "\"" << TIMER_NAMES[i] << "\": {\"calls\": "
+                    << this->calls[i] << ", \"seconds\": " << this->nanoseconds[i] * 1e-9 << "}";
+        out << "}";
+    }
+};
+
+// Adds the time from construction to destruction to stats, if active and timers are compiled in.
+// Recursive traversals pass active only at the root, so that nested calls aren't counted twice.
+class ScopedTimer {
+private:
+    Stats* stats = nullptr;
+    Timer timer;
+    std::chrono::steady_clock::time_point start;
+public:
+    ScopedTimer(Stats* stats, Timer timer, bool active = true) : timer(timer) {
+        if constexpr (STATS_TIMERS_ENABLED) {
+            if (active && stats) {
+                this->stats = stats;
+                this->start = std::chrono::steady_clock::now();
+            }
+        }
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    ~ScopedTimer() {
+        if constexpr (STATS_TIMERS_ENABLED) {
+            if (this->stats) {
+                auto elapsed = std::chrono::steady_clock::now() - this->start;
+                this->stats->add_time(this->timer,
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+            }
+        }
+    }
+};
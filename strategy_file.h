@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Binary file holding a trained solver. It starts with a StrategyHeader, followed by three
+// sections of n_info_sets * n_actions doubles, rows indexed by info-set id: the normalized
+// average strategy, then the regret and strategy sums needed to resume training. Every section
+// starts on a 64-byte boundary, so a mapped file can be read in place.
+
+const char STRATEGY_MAGIC[8] = {'C', 'F', 'R', 'S', 'T', 'R', 'A', 'T'};
+const uint32_t STRATEGY_VERSION = 1;
+
+struct StrategyHeader {
+    char magic[8];
+    // which game and configuration the tables belong to, zero-padded
+    char game[16];
+    uint32_t version;
+    uint32_t n_actions;
+    uint64_t n_info_sets;
+    // training iterations completed when the file was written
+    uint64_t iteration;
+
+    StrategyHeader() = default;
+
+    StrategyHeader(const std::string& game, int n_actions, long n_info_sets, long iteration) :
+        version(STRATEGY_VERSION), n_actions(n_actions), n_info_sets(n_info_sets),
+        iteration(iteration) {
+        std::memcpy(this->magic, STRATEGY_MAGIC, sizeof(this->magic));
+        std::memset(this->game, 0, sizeof(this->game));
+        std::strncpy(this->game, game.c_str(), sizeof(this->game) - 1);
+    }
+
+    // Returns the byte offset of section i (0 = average strategy, 1 = regrets, 2 = strategy sums)
+    std::size_t get_offset(int i) const {
+        return 64 + i * get_section_size();
+    }
+
+    std::size_t get_section_size() const {
+        return (this->n_info_sets * this->n_actions * sizeof(double) + 63) / 64 * 64;
+    }
+
+    std::size_t get_file_size() const { return this->get_offset(3); }
+
+    std::string get_game() const {
+        return std::string(this->game, strnlen(this->game, sizeof(this->game)));
+    }
+};
+
+static_assert(sizeof(StrategyHeader) <= 64, "header must fit before the first section");
+
+// Write the tables to path. The file is written beside path and renamed over it, so readers
+// never observe a partial file.
+inline void write_strategy_file(const std::string& path, const StrategyHeader& header,
+                                const double* average_strategy, const double* regret_sum,
+                                const double* strategy_sum) {
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out)
+            throw std::runtime_error("could not open " + tmp + " for writing.");
+
+        const char zeros[64] = {};
+        std::size_t n = header.n_info_sets * header.n_actions * sizeof(double);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(zeros, 64 - sizeof(header));
+        for (const double* section : {average_strategy, regret_sum, strategy_sum}) {
+            out.write(reinterpret_cast<const char*>(section), n);
+            out.write(zeros, header.get_section_size() - n);
+        }
+        if (!out)
+            throw std::runtime_error("failed writing " + tmp + ".");
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0)
+        throw std::runtime_error("could not rename " + tmp + " to " + path + ".");
+}
+
+// Read-only, zero-copy view of a strategy file. The file is mapped shared, so every process that
+// maps the same file reads the same physical pages.
+class StrategyImage {
+private:
+    void* data = nullptr;
+    std::size_t size = 0;
+
+    const double* get_section(int i) const {
+        return reinterpret_cast<const double*>(
+            static_cast<const char*>(this->data) + this->get_header().get_offset(i));
+    }
+public:
+    StrategyImage() = default;
+
+    // Map path, checking only that it is a strategy file, of any game and size
+    explicit StrategyImage(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd == -1)
+            throw std::runtime_error("could not open " + path + ".");
+        struct stat st;
+        if (fstat(fd, &st) == -1 || (std::size_t) st.st_size < sizeof(StrategyHeader)) {
+            close(fd);
+            throw std::runtime_error(path + " is not a strategy file.");
+        }
+        this->size = st.st_size;
+        this->data = mmap(nullptr, this->size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (this->data == MAP_FAILED) {
+            this->data = nullptr;
+            throw std::runtime_error("could not map " + path + ".");
+        }
+
+        const StrategyHeader& header = this->get_header();
+        if (std::memcmp(header.magic, STRATEGY_MAGIC, sizeof(header.magic)) != 0 ||
+            header.version != STRATEGY_VERSION || this->size < header.get_file_size()) {
+            munmap(this->data, this->size);
+            this->data = nullptr;
+            throw std::runtime_error(path + " is not a strategy file.");
+        }
+    }
+
+    // Map path, checking that it holds tables for game with the expected dimensions
+    StrategyImage(const std::string& path, const std::string& game, int n_actions,
+                  long n_info_sets) : StrategyImage(path) {
+        const StrategyHeader& header = this->get_header();
+        StrategyHeader expected(game, n_actions, n_info_sets, 0);
+        if (std::memcmp(header.game, expected.game, sizeof(header.game)) != 0 ||
+            header.n_actions != expected.n_actions || header.n_info_sets != expected.n_info_sets)
+            throw std::runtime_error(path + " does not hold a " + game + " strategy of this size.");
+    }
+
+    StrategyImage(const StrategyImage&) = delete;
+    StrategyImage& operator=(const StrategyImage&) = delete;
+
+    StrategyImage(StrategyImage&& other) noexcept :
+        data(std::exchange(other.data, nullptr)), size(std::exchange(other.size, 0)) {}
+
+    StrategyImage& operator=(StrategyImage&& other) noexcept {
+        std::swap(this->data, other.data);
+        std::swap(this->size, other.size);
+        return *this;
+    }
+
+    ~StrategyImage() {
+        if (this->data)
+            munmap(this->data, this->size);
+    }
+
+    bool is_loaded() const { return this->data != nullptr; }
+
+    const StrategyHeader& get_header() const {
+        return *static_cast<const StrategyHeader*>(this->data);
+    }
+
+    // Row i * n_actions holds the normalized average strategy of information set i
+    const double* get_average_strategy() const { return this->get_section(0); }
+
+    const double* get_regret_sum() const { return this->get_section(1); }
+
+    const double* get_strategy_sum() const { return this->get_section(2); }
+};
@@ -0,0 +1,424 @@
+#include "dudo.h"
+#include "kuhn.h"
+#include "rps.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// Checks of solver behavior that no single training run shows, such as how fast the options
+// converge against each other. Every test trains for seconds, ten at most.
+// usage: tests [NAME]...
+// runs the named tests, or every test, and exits with 1 if any of them failed.
+
+void check(bool ok, const string& message) {
+    if (!ok)
+        throw runtime_error(message);
+}
+
+double train_dudo(SolverOptions options, int T) {
+    dudo::Solver solver(options);
+    solver.train(T);
+    return solver.compute_exploitability();
+}
+
+// Returns the regret sums of solver followed by its strategy sums, as its strategy file holds them
+template <class Solver>
+vector<double> get_sums(const Solver& solver) {
+    string path = "tests_sums.strategy";
+    solver.save(path);
+    StrategyImage image = solver.load(path);
+    remove(path.c_str());
+    long n = image.get_header().n_info_sets * image.get_header().n_actions;
+    vector<double> sums(image.get_regret_sum(), image.get_regret_sum() + n);
+    sums.insert(sums.end(), image.get_strategy_sum(), image.get_strategy_sum() + n);
+    return sums;
+}
+
+// Returns whether sums a and b differ by no more than rounding
+bool is_close(const vector<double>& a, const vector<double>& b) {
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i)
+        if (abs(a[i] - b[i]) > 1e-9 * (1 + abs(a[i])))
+            return false;
+    return true;
+}
+
+// Sequential full-width iterations are single deals, but the update rules count passes over
+// every deal, so CFR+ and DCFR beat CFR there as they do in every other mode: they reach a
+// hundredth of the uniform strategy's exploitability, which scales with the game, in fewer passes
+void test_sequential_policies() {
+    int n_deals = dudo::NUM_ROLLS * dudo::NUM_ROLLS;
+    double target = dudo::Solver().compute_exploitability() / 100;
+    // checking every few passes is enough to count them
+    int check_every = 4 * n_deals;
+    dudo::Solver cfr;
+    cfr.train_until(target, check_every);
+    long cfr_passes = cfr.get_iteration() / n_deals;
+    for (RegretPolicy policy : {RegretPolicy::CFR_PLUS, RegretPolicy::DCFR}) {
+        dudo::Solver solver({.policy = policy});
+        // stop a check short of what CFR took, after which it's no better
+        double exploitability =
+            solver.train_until(target, check_every, cfr.get_iteration() - check_every);
+        string name = (policy == RegretPolicy::CFR_PLUS) ? "CFR+" : "DCFR";
+        cout << "CFR " << cfr_passes << " passes, " << name << ' '
+             << solver.get_iteration() / n_deals << " passes\n";
+        check(exploitability < target, name + " is no better than CFR");
+    }
+}
+
+// A table of smaller rules, as strategy files of other builds are read with, has every legal
+// action of every history lead to a history, with dudo ending the game on the claims it
+// challenges. The rules drop a side, or a die when there are only two sides; the smallest
+// configuration has no smaller rules.
+void test_smaller_rules_table() {
+    dudo::Rules rules;
+    if (dudo::NUM_SIDES > 2)
+        rules = {dudo::NUM_DICE, dudo::NUM_SIDES - 1};
+    else if (dudo::NUM_DICE > 1)
+        rules = {dudo::NUM_DICE - 1, dudo::NUM_SIDES};
+    else {
+        cout << "no rules are smaller than " << dudo::GAME << ", skipped\n";
+        return;
+    }
+    dudo::InfoSetTable table(rules);
+    int dudo = rules.get_dudo();
+    for (int h = 0; h < table.get_n_histories(); ++h) {
+        if (table.is_terminal(h))
+            continue;
+        string history = "history " + to_string(h);
+        check(table.get_last_action(h) <= dudo + 1, history + " has actions outside the rules");
+        for (int a = 0; a < dudo::NUM_ACTIONS; ++a) {
+            int child = table.get_child(h, a);
+            bool legal = (a >= table.get_first_action(h) && a < table.get_last_action(h));
+            check((child != -1) == legal, history + " has the wrong actions");
+            if (!legal)
+                continue;
+            uint32_t claims =
+                rules.get_recalled_claims(table.get_claims(h) | ((a == dudo) ? 0 : 1u << a));
+            check(table.is_terminal(child) == (a == dudo) && table.get_claims(child) == claims,
+                  history + " followed by " + to_string(a) + " is the wrong history");
+        }
+    }
+}
+
+// Strategy files tagged with rules larger than this build's, or that aren't rules at all, are
+// turned away before any table is built from their tags, as warm starts load them
+void test_untrusted_rules() {
+    string path = "tests_untrusted_rules.strategy";
+    int sides = dudo::NUM_SIDES + 2;
+    string larger = dudo::Rules{dudo::NUM_DICE, sides, 2 * dudo::NUM_DICE * sides}.get_name();
+    for (string tag : {larger, string("dudo-200x6"), string("dudo--2x6"), string("dudo-2x6-r0")}) {
+        write_strategy_file(path, StrategyHeader(tag, 1, 0, 0), nullptr, nullptr, nullptr);
+        StrategyImage image(path);
+        bool rejected = false;
+        try {
+            dudo::InfoSetTable source(dudo::Rules::parse(image.get_header().get_game()));
+        } catch (const runtime_error& e) {
+            cout << e.what() << '\n';
+            rejected = true;
+        }
+        check(rejected, "a file tagged " + tag + " is loaded");
+    }
+    remove(path.c_str());
+}
+
+// Walk histories h of table and full of a perfect recall one together, checking that h plays
+// out like full and remembers its most recent claims. Returns the number of histories walked.
+long walk_recalled(const dudo::InfoSetTable& table, int h, const dudo::InfoSetTable& full,
+                   int f) {
+    const dudo::Rules& rules = table.get_rules();
+    check(table.is_terminal(h) == full.is_terminal(f) &&
+              table.get_player(h) == full.get_player(f) &&
+              table.get_claims(h) == rules.get_recalled_claims(full.get_claims(f)),
+          "history " + to_string(h) + " isn't what it stands for");
+    if (table.is_terminal(h))
+        return 1;
+    check(table.get_first_action(h) == full.get_first_action(f) &&
+              table.get_last_action(h) == full.get_last_action(f),
+          "history " + to_string(h) + " has the wrong actions");
+    long n = 1;
+    for (int a = table.get_first_action(h); a < table.get_last_action(h); ++a)
+        n += walk_recalled(table, table.get_child(h, a), full, full.get_child(f, a));
+    return n;
+}
+
+// With bounded recall, histories that only differ in forgotten claims share an id, so the table
+// stays as small as the recall makes the information sets, while walks still see the whole tree
+void test_bounded_recall_table() {
+    dudo::Rules rules = {dudo::NUM_DICE, dudo::NUM_SIDES, 3};
+    dudo::InfoSetTable table(rules), full(dudo::Rules{dudo::NUM_DICE, dudo::NUM_SIDES,
+                                                     dudo::DUDO});
+    long n_keys = 0;
+    for (int k = 0; k <= rules.recall; ++k)
+        n_keys += dudo::binomial(rules.get_dudo(), k);
+    check(table.get_n_histories() <= 4 * n_keys, "the recalled claim tree isn't bounded");
+    check(walk_recalled(table, dudo::InfoSetTable::ROOT, full, dudo::InfoSetTable::ROOT) ==
+              full.get_n_histories(),
+          "walks don't see the whole claim tree");
+}
+
+// Pruning grows the regrets of the actions it skips by as much as they could have grown, so a
+// pruned solve keeps up with an unpruned one, sequentially, on the public tree and in threads
+void test_pruning() {
+    SolverOptions sequential, public_tree, threaded;
+    public_tree.public_tree = true;
+    threaded.n_threads = 2;
+    int passes = 200;
+    for (SolverOptions options : {sequential, public_tree, threaded}) {
+        int T = (options.public_tree || options.n_threads > 1)
+            ? passes : passes * dudo::NUM_ROLLS * dudo::NUM_ROLLS;
+        double unpruned = train_dudo(options, T);
+        options.prune_threshold = -1;
+        double pruned = train_dudo(options, T);
+        cout << "unpruned " << unpruned << ", pruned " << pruned << '\n';
+        check(pruned < 1.2 * unpruned, "pruning slows convergence down");
+    }
+}
+
+// A solve resumed from its checkpoint carries on exactly as if it had never stopped
+void test_checkpoint_resume() {
+    int n_deals = dudo::NUM_ROLLS * dudo::NUM_ROLLS, T = 10 * n_deals;
+    string path = "tests_checkpoint.strategy";
+    for (RegretPolicy policy : {RegretPolicy::CFR, RegretPolicy::DCFR}) {
+        {
+            // the first call adds a pass, and the checkpoint is written once the solver goes
+            dudo::Solver first({.policy = policy});
+            first.set_checkpoint(path, T + n_deals);
+            first.train(T);
+        }
+        dudo::Solver resumed({.policy = policy});
+        resumed.resume(resumed.load(path));
+        check(resumed.get_iteration() == T + n_deals, "the checkpoint is of the wrong iteration");
+        resumed.train(T);
+        remove(path.c_str());
+        dudo::Solver uninterrupted({.policy = policy});
+        uninterrupted.train(2 * T);
+        check(get_sums(resumed) == get_sums(uninterrupted),
+              "a resumed solve trains differently from an uninterrupted one");
+    }
+}
+
+// A reset solver draws the same samples and rounds the same way as a fresh one with its seed
+void test_reset() {
+    int T = 1000;
+    dudo::FloatSolver fresh({.sampling = Sampling::EXTERNAL});
+    fresh.train(T);
+    dudo::FloatSolver reset({.sampling = Sampling::EXTERNAL});
+    reset.train(T);
+    reset.reset();
+    reset.train(T);
+    check(get_sums(reset) == get_sums(fresh), "a reset solve trains differently from a fresh one");
+}
+
+// Bulk draws are uniform doubles in [0, 1) that a stream repeats once seeded again, and that
+// neither repeat its own draws nor come out in runs of one value across the lanes
+void test_bulk_draws() {
+    Rng rng(1), single(1);
+    vector<double> first(1003), again(1003);
+    rng.fill_uniform(first.data(), first.size());
+    rng.seed(1);
+    rng.fill_uniform(again.data(), again.size());
+    check(first == again, "a reseeded stream draws differently in bulk");
+    double sum = 0;
+    for (size_t i = 0; i < first.size(); ++i) {
+        check(first[i] >= 0 && first[i] < 1, "a bulk draw is outside [0, 1)");
+        check(i == 0 || first[i] != first[i - 1], "neighbouring lanes draw the same");
+        check(first[i] != single.uniform(), "the lanes repeat the stream's own draws");
+        sum += first[i];
+    }
+    check(abs(sum / first.size() - 0.5) < 0.05, "bulk draws aren't uniform");
+}
+
+// A cluster of one rank walks every deal of an iteration in order and merges into the same sums,
+// up to the rounding of adding its updates back onto the last merge, so it trains like a
+// sequential solve, whose first call adds a pass of its own
+void test_one_rank_cluster() {
+    int n_deals = dudo::NUM_ROLLS * dudo::NUM_ROLLS, passes = 20;
+    for (Sampling sampling : {Sampling::NONE, Sampling::EXTERNAL}) {
+        bool full_width = (sampling == Sampling::NONE);
+        dudo::Solver sequential({.sampling = sampling});
+        sequential.train(full_width ? (passes - 1) * n_deals : passes);
+        dudo::Solver clustered({.sampling = sampling});
+        clustered.set_cluster(make_shared<Cluster>("localhost", 0, 0, 1), 5);
+        clustered.train(passes);
+        check(is_close(get_sums(clustered), get_sums(sequential)),
+              "a one-rank cluster trains differently from a sequential solve");
+    }
+}
+
+// Returns the largest difference between an action's probability in quantized and in policy
+template <class P>
+double get_quantization_error(const P& quantized, const Policy& policy) {
+    double error = 0;
+    for (int i = 0; i < policy.get_n_info_sets(); ++i)
+        for (int a = 0; a < policy.get_n_actions(); ++a)
+            error = max(error, abs(quantized.get_probability(i, a) - policy.get_probability(i, a)));
+    return error;
+}
+
+// Quantized policies play every action within a step of its probability, and a bot serves them
+void test_quantized_policy() {
+    dudo::Solver solver;
+    solver.train(100 * dudo::NUM_ROLLS * dudo::NUM_ROLLS);
+    auto policy = solver.get_policy();
+    double error16 = get_quantization_error(*solver.get_policy<uint16_t>(), *policy);
+    double error8 = get_quantization_error(*solver.get_policy<uint8_t>(), *policy);
+    cout << "16-bit error " << error16 << ", 8-bit error " << error8 << '\n';
+    check(error16 <= 1.0 / UINT16_MAX + 1e-12, "a 16-bit policy is off by more than a step");
+    check(error8 <= 1.0 / UINT8_MAX + 1e-12, "an 8-bit policy is off by more than a step");
+
+    // a bot serving the 8-bit policy plays the king at the root as often as the full one says
+    kuhn::Solver kuhn_solver;
+    kuhn_solver.train(1000);
+    kuhn::Bot bot(kuhn_solver.get_policy<uint8_t>());
+    int n = 10000, card = kuhn::NUM_CARDS;
+    vector<kuhn::Query> queries(n, {card, kuhn::InfoSetTable::ROOT});
+    vector<int> actions;
+    Rng rng;
+    bot.act(queries, actions, rng);
+    double bet = count(actions.begin(), actions.end(), 1) / (double) n;
+    int i = kuhn_solver.get_table().get_info_set(card, kuhn::InfoSetTable::ROOT);
+    check(abs(bet - kuhn_solver.get_policy()->get_probability(i, 1)) < 0.03,
+          "an 8-bit bot doesn't bet as often as the policy");
+}
+
+// Returns every action probability of policy, row by row
+vector<double> get_probabilities(const Policy& policy) {
+    vector<double> probabilities;
+    for (int i = 0; i < policy.get_n_info_sets(); ++i)
+        for (int a = 0; a < policy.get_n_actions(); ++a)
+            probabilities.push_back(policy.get_probability(i, a));
+    return probabilities;
+}
+
+// Training publishes new snapshots while readers play from old ones: a snapshot a reader holds
+// stays as it was across publishes, while the slot serves each newer one whole
+void test_policy_publish() {
+    kuhn::Solver solver;
+    auto slot = make_shared<PolicySlot<>>();
+    int every = 60, n_publishes = 20;
+    solver.set_publish(slot, every);
+    // train up to a publish, so every later call of every iterations ends on one
+    solver.train(every);
+    if (solver.get_iteration() % every != 0)
+        solver.train(every - solver.get_iteration() % every);
+    shared_ptr<const Policy> held = slot->get();
+    check(held != nullptr, "training didn't publish a snapshot");
+    vector<double> before = get_probabilities(*held);
+
+    // a reader on another thread keeps taking snapshots, each of which must be whole
+    atomic<bool> done = false;
+    atomic<int> n_seen = 0, n_broken = 0;
+    thread reader([&] {
+        shared_ptr<const Policy> last = held;
+        while (!done) {
+            shared_ptr<const Policy> policy = slot->get();
+            if (policy != last)
+                ++n_seen;
+            last = policy;
+            vector<double> p = get_probabilities(*policy);
+            for (size_t i = 0; i < p.size(); i += kuhn::NUM_ACTIONS)
+                if (abs(p[i] + p[i + 1] - 1) > 1e-12)
+                    ++n_broken;
+        }
+    });
+    // publish, and wait for the reader to take the new snapshot before publishing the next
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(10);
+    for (int k = 1; k <= n_publishes; ++k) {
+        solver.train(every);
+        while (n_seen < k && chrono::steady_clock::now() < deadline)
+            this_thread::yield();
+    }
+    done = true;
+    reader.join();
+
+    check(n_seen == n_publishes, "the reader saw " + to_string(n_seen) + " of " +
+                                     to_string(n_publishes) + " snapshots");
+    check(n_broken == 0, "a reader saw a snapshot that isn't a policy");
+    check(get_probabilities(*held) == before, "a held snapshot changed across a publish");
+    check(slot->get() != held &&
+              get_probabilities(*slot->get()) == get_probabilities(*solver.get_policy()),
+          "the slot doesn't serve the latest snapshot");
+}
+
+// A matrix game sized at runtime solves like the same game sized at compile time
+void test_runtime_matrix() {
+    DenseMatrix<DYNAMIC_ACTIONS> utility = {rps::NUM_ACTIONS, {}};
+    for (const auto& row : rps::UTILITY.matrix)
+        utility.matrix.insert(utility.matrix.end(), row.begin(), row.end());
+    MatrixGameSolver<> runtime(utility, rps::NUM_ACTIONS);
+    rps::Solver fixed(rps::UTILITY);
+    // sampled from the same seed, so both draw the same actions
+    runtime.train_sampled(100000);
+    fixed.train_sampled(100000);
+    for (int p = 0; p < 2; ++p) {
+        vector<double> s = runtime.get_average_strategy(p);
+        auto f = fixed.get_average_strategy(p);
+        check(is_close(s, vector<double>(f.begin(), f.end())),
+              "player " + to_string(p) + " plays another strategy");
+    }
+    check(runtime.get_exploitability() < 0.01, "the runtime-sized game isn't solved");
+}
+
+// A policy served from a mapped strategy file plays what a copy of it on the heap plays
+void test_image_policy() {
+    kuhn::Solver solver;
+    solver.train(1000);
+    string path = "tests_image_policy.strategy";
+    solver.save(path);
+    StrategyImage image(path, kuhn::GAME, kuhn::NUM_ACTIONS,
+                        solver.get_table().get_n_info_sets());
+    Policy policy(image);
+    ImagePolicy served(std::move(image));
+    remove(path.c_str());
+    for (int i = 0; i < policy.get_n_info_sets(); ++i)
+        for (int k = 0; k < 1000; ++k)
+            check(served.sample(i, (k + 0.5) / 1000) == policy.sample(i, (k + 0.5) / 1000),
+                  "information set " + to_string(i) + " plays another action");
+}
+
+const vector<pair<string, function<void()>>> TESTS = {
+    {"sequential_policies", test_sequential_policies},
+    {"smaller_rules_table", test_smaller_rules_table},
+    {"untrusted_rules", test_untrusted_rules},
+    {"bounded_recall_table", test_bounded_recall_table},
+    {"pruning", test_pruning},
+    {"image_policy", test_image_policy},
+    {"runtime_matrix", test_runtime_matrix},
+    {"quantized_policy", test_quantized_policy},
+    {"policy_publish", test_policy_publish},
+    {"one_rank_cluster", test_one_rank_cluster},
+    {"checkpoint_resume", test_checkpoint_resume},
+    {"reset", test_reset},
+    {"bulk_draws", test_bulk_draws},
+};
+
+int main(int argc, char** argv) {
+    vector<string> names(argv + 1, argv + argc);
+    bool failed = false;
+    for (const auto& [name, test] : TESTS) {
+        if (!names.empty() && find(names.begin(), names.end(), name) == names.end())
+            continue;
+        try {
+            test();
+            cout << name << ": passed\n";
+        } catch (const exception& e) {
+            cout << name << ": FAILED: " << e.what() << '\n';
+            failed = true;
+        }
+    }
+    return failed ? 1 : 0;
+}
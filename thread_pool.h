@@ -0,0 +1,80 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Fixed set of threads that run one job at a time on every thread, fork-join style. The thread
+// calling run() takes part as thread 0, so a pool of size 1 spawns nothing.
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::function<void(int)> job;
+    std::mutex mutex;
+    std::condition_variable start, done;
+    long generation = 0;
+    int pending = 0;
+    bool stopping = false;
+
+    void work(int thread) {
+        long seen = 0;
+        while (true) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->start.wait(lock, [&] { return this->stopping || this->generation != seen; });
+            if (this->stopping)
+                return;
+            seen = this->generation;
+            lock.unlock();
+
+            this->job(thread);
+
+            lock.lock();
+            if (--this->pending == 0)
+                this->done.notify_one();
+        }
+    }
+public:
+    explicit ThreadPool(int n_threads) {
+        for (int t = 1; t < n_threads; ++t)
+            this->workers.emplace_back(&ThreadPool::work, this, t);
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->start.notify_all();
+        for (std::thread& worker : this->workers)
+            worker.join();
+    }
+
+    int size() const { return this->workers.size() + 1; }
+
+    // Run job(thread) for every thread in [0, size()) and wait for all of them to finish
+    void run(std::function<void(int)> job) {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->job = std::move(job);
+            this->pending = this->workers.size();
+            ++this->generation;
+        }
+        this->start.notify_all();
+        this->job(0);
+
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->done.wait(lock, [&] { return this->pending == 0; });
+    }
+
+    // Returns the contiguous chunk [first, second) of [0, n) that belongs to thread
+    std::pair<int, int> get_range(int thread, int n) const {
+        int size = this->size();
+        return {int((long) n * thread / size), int((long) n * (thread + 1) / size)};
+    }
+};